@@ -0,0 +1,1136 @@
+// Microbenchmarks for the hot paths of the plug, run without a window or an audio device:
+// music streams load but get no device buffer, so nothing is ever played.
+//
+// Results go to stdout as tab separated `name median_ns mad_ns ops` lines.
+// Given a baseline in that same format, every benchmark is compared against it and the
+// run fails if one got slower by more than the tolerance or than the noise of both runs,
+// and still is after being measured again.
+#include "plug.c"
+
+#include <sched.h>
+#include <getopt.h>
+
+#define BENCH_REPS 15
+#define BENCH_DEFAULT_TOLERANCE .10
+#define BENCH_NOISE_SIGMAS 3.
+#define BENCH_RETRIES 2
+#define BENCH_NAME_CAP 64
+#define BENCH_RESULTS_CAP 64
+
+#define BENCH_SONGS 10000
+#define BENCH_PATHS 100000
+#define BENCH_TRACKS 8
+#define BENCH_TRACK_SECONDS 2
+#define BENCH_STRETCH_FRAMES 1024
+#define BENCH_DECODE_SECONDS 10
+#define BENCH_DECODE_ENV "BENCH_DECODE_FILE"
+#define BENCH_MODULE_PATTERNS 8
+#define BENCH_MODULE_SAMPLE_LEN 64 // Bytes, one period of the sine
+#define BENCH_LIBRARY_CHANGES 10000
+#define BENCH_FRAME_SECONDS (1.0/60)
+#define BENCH_PLAYLIST_LINES 1000000
+#define BENCH_PREFLIGHT_TAG_BYTES (300*1024) // Past the probe, as with big cover art
+#define BENCH_PREFLIGHT_MP3_FRAMES 200
+#define BENCH_FP_TRACKS 100000
+#define BENCH_FP_FRAMES 256
+#define BENCH_FP_QUERIES 100
+
+typedef struct {
+    const char* name;
+    void (*setup)(void);
+    void (*run)(size_t ops);
+    void (*teardown)(void);
+    size_t ops;
+    void (*reset)(void); // Before every run, outside of the timing
+} Bench;
+
+typedef struct {
+    char name[BENCH_NAME_CAP];
+    double median;
+    double mad;
+    size_t ops;
+} Bench_Result;
+
+typedef struct {
+    Bench_Result items[BENCH_RESULTS_CAP];
+    size_t count;
+} Bench_Results;
+
+static char (*bench_paths)[TEXT_CAP / 4];
+static char bench_dir_template[] = "/tmp/player-bench-XXXXXX";
+static char bench_dir[sizeof(bench_dir_template)];
+static float* bench_frames;
+static volatile size_t bench_sink;
+
+static int compare_doubles(const void* a, const void* b)
+{
+    const double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static void bench_reset_plug(void)
+{
+    free(plug->pl.songs);
+    memset(plug, 0, sizeof(*plug));
+    plug->music_volume = DEFAULT_MUSIC_VOLUME;
+    plug->music_speed = 1.f;
+    srand(69);
+}
+
+static void bench_fill_playlist(size_t n)
+{
+    char path[TEXT_CAP];
+    DA_RESERVE(plug->pl, n);
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(path, sizeof(path), "/home/user/Music/Artist %zu/Album %zu/%03zu - Track.mp3", i % 97, i % 13, i);
+        DA_PUSH(plug->pl, new_song(path, 0));
+        plug->pl.songs[i].id = ++plug->pl.last_id;
+    }
+
+    // Some of them skipped, as the duplicate detection and the pre-flight check would leave them
+    for (size_t i = 0; i < n; i += 10) plug->pl.songs[i].duplicate_of = 1;
+    for (size_t i = 5; i < n; i += 20) plug->pl.songs[i].check_state = CHECK_BAD;
+}
+
+// From an empty playlist every run, see the reset of its entry
+static void bench_da_push(size_t ops)
+{
+    const Song song = new_song("/home/user/Music/Artist/Album/01 - Track.mp3", 0);
+    for (size_t i = 0; i < ops; ++i) DA_PUSH(plug->pl, song);
+}
+
+static void bench_shuffle_setup(void)
+{
+    bench_reset_plug();
+    bench_fill_playlist(BENCH_SONGS);
+    plug->shuffle_mode = true;
+}
+
+static void bench_pull_next_shuffle(size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        plug->pl.prev = plug->pl.curr;
+        plug->pl.curr = plug_pull_next_song();
+    }
+}
+
+static void bench_pull_prev_shuffle(size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        plug->pl.curr = plug_pull_prev_song();
+        plug->pl.prev = plug->pl.curr;
+    }
+}
+
+static void bench_paths_setup(void)
+{
+    static const char* exts[] = {".mp3", ".MP3", ".flac", ".ogg", ".wav", ".jpg", ".txt", ".xm", ".qoa", ""};
+
+    bench_paths = malloc(BENCH_PATHS*sizeof(*bench_paths));
+    assert(bench_paths != NULL && "Buy more RAM lol");
+
+    for (size_t i = 0; i < BENCH_PATHS; ++i)
+        snprintf(bench_paths[i], sizeof(*bench_paths), "/home/user/Music/Artist %zu/Album %zu/%03zu - Some Track Name%s",
+                 i % 97, i % 13, i % 1000, exts[i % DA_LEN(exts)]);
+}
+
+static void bench_paths_teardown(void)
+{
+    free(bench_paths);
+    bench_paths = NULL;
+}
+
+static void bench_is_music(size_t ops)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < ops; ++i) n += is_music(bench_paths[i % BENCH_PATHS]);
+    bench_sink = n;
+}
+
+static void bench_get_song_name(size_t ops)
+{
+    char name[TEXT_CAP];
+    for (size_t i = 0; i < ops; ++i) {
+        get_song_name(bench_paths[i % BENCH_PATHS], name, sizeof(name));
+        bench_sink = name[0];
+    }
+}
+
+static void bench_track_switch_setup(void)
+{
+    bench_reset_plug();
+    strcpy(bench_dir, bench_dir_template);
+    const char* dir = mkdtemp(bench_dir);
+    assert(dir != NULL && "Couldn't create the benchmark directory");
+
+    const uint32_t frames = MODULE_RENDER_RATE*BENCH_TRACK_SECONDS;
+    short* samples = malloc(frames*2*sizeof(*samples));
+    assert(samples != NULL && "Buy more RAM lol");
+
+    char path[TEXT_CAP];
+    for (size_t t = 0; t < BENCH_TRACKS; ++t) {
+        for (uint32_t i = 0; i < frames*2; ++i) samples[i] = (short) (sinf(i*(t + 1)*.01f)*8000);
+        snprintf(path, sizeof(path), "%s/%zu.wav", dir, t);
+        const Wave wave = { .frameCount = frames, .sampleRate = MODULE_RENDER_RATE, .sampleSize = 16, .channels = 2, .data = samples };
+        const bool written = ExportWave(wave, path);
+        assert(written && "Couldn't write a benchmark track");
+        DA_PUSH(plug->pl, new_song(path, 0));
+        plug->pl.songs[t].id = ++plug->pl.last_id;
+    }
+    free(samples);
+
+    plug->pl.curr = 0;
+}
+
+static void bench_track_switch(size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) plug_next_song();
+}
+
+static void bench_track_switch_teardown(void)
+{
+    if (plug->music_loaded) plug_unload_music();
+    for (size_t t = 0; t < plug->pl.count; ++t) unlink(plug->pl.songs[t].path);
+    rmdir(bench_dir);
+    bench_reset_plug();
+}
+
+// The playing file cut in half on disk, the way a tagger or a sync client rewriting it does.
+// Refills read all of the copy the stream plays from and a background decode reads what's left
+// of the file, neither may fault. The file is put back from that copy for the next switch.
+static void bench_truncate_playing(size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        plug_next_song();
+        assert(plug->music_loaded && "Couldn't load a benchmark track");
+
+        const char* path = plug_get_curr_song()->path;
+        const Music_Data* data = &plug->curr_music_data;
+        const int truncated = truncate(path, data->size/2);
+        assert(truncated == 0 && "Couldn't truncate the benchmark track");
+
+        bench_sink = hash_bytes(data->data, data->size);
+        UpdateMusicStream(plug->curr_music);
+#ifdef STREAM_DECODE
+        static short chunk[DECODER_CHUNK_FRAMES*DECODER_MAX_CHANNELS];
+        Decoder* dec = decoder_open(path);
+        if (dec) {
+            for (size_t n; (n = decoder_read(dec, chunk, DECODER_CHUNK_FRAMES)) > 0;) bench_sink += n;
+            decoder_close(dec);
+        }
+#endif
+
+        const bool restored = SaveFileData(path, data->data, data->size);
+        assert(restored && "Couldn't restore the benchmark track");
+    }
+}
+
+static void bench_stretch_setup(void)
+{
+    bench_frames = malloc(BENCH_STRETCH_FRAMES*2*sizeof(*bench_frames));
+    assert(bench_frames != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < BENCH_STRETCH_FRAMES*2; ++i) bench_frames[i] = sinf(i*.02f);
+    time_stretch_reset(&plug->stretch, 2);
+}
+
+static void bench_stretch_teardown(void)
+{
+    free(bench_frames);
+    bench_frames = NULL;
+}
+
+// Per device buffer, that's what the audio thread has to keep up with. x1.00 is the pass-through
+// through the ring after a speed change.
+// The buffer is processed in place over and over, it stays audio-like enough for the splice search.
+static void bench_stretch(size_t ops, float speed)
+{
+    atomic_store(&plug->stretch.ratio, 1.f / speed);
+    for (size_t i = 0; i < ops; ++i) time_stretch_process(&plug->stretch, bench_frames, BENCH_STRETCH_FRAMES);
+}
+
+static void bench_stretch_x050(size_t ops) { bench_stretch(ops, .5f); }
+static void bench_stretch_x100(size_t ops) { bench_stretch(ops, 1.f); }
+static void bench_stretch_x200(size_t ops) { bench_stretch(ops, 2.f); }
+static void bench_stretch_x300(size_t ops) { bench_stretch(ops, 3.f); }
+
+// A stream that started at x1.00
+static void bench_stretch_switch_setup(void)
+{
+    atomic_store(&plug->stretch.ratio, 1.f);
+    bench_stretch_setup();
+}
+
+// Flips between x1.00 and x1.50 every buffer, like holding ] and [, on a fresh sine sped up the
+// way SetMusicPitch() does. No 128 frame window of the output may go quiet, as it did while the
+// ring filled up again. Crossfading across a pitch change beats, that only dips it.
+static void bench_stretch_switch(size_t ops)
+{
+    static size_t buffers;
+    static float angle;
+    for (size_t i = 0; i < ops; ++i) {
+        const float speed = buffers++ % 2 ? 1.5f : 1.f;
+        atomic_store(&plug->stretch.ratio, 1.f / speed);
+        for (size_t f = 0; f < BENCH_STRETCH_FRAMES; ++f) {
+            bench_frames[f*2] = bench_frames[f*2 + 1] = sinf(angle);
+            angle = fmodf(angle + .05f*speed, 2.f*PI);
+        }
+
+        time_stretch_process(&plug->stretch, bench_frames, BENCH_STRETCH_FRAMES);
+
+        for (size_t w = 0; w < BENCH_STRETCH_FRAMES; w += 128) {
+            float peak = 0.f;
+            for (size_t f = w; f < w + 128; ++f) peak = MAX(peak, fabsf(bench_frames[f*2]));
+            assert(peak > .25f && "The speed change dropped out");
+        }
+    }
+}
+
+static char bench_playlist_template[] = "/tmp/player-bench-playlist-XXXXXX";
+static char bench_playlist_dir[sizeof(bench_playlist_template)];
+static char bench_playlist_path[TEXT_CAP];
+
+// Relative entries, so every line also gets resolved against the playlist's directory
+static void bench_playlist_setup(void)
+{
+    bench_reset_plug();
+    strcpy(bench_playlist_dir, bench_playlist_template);
+    const char* dir = mkdtemp(bench_playlist_dir);
+    assert(dir != NULL && "Couldn't create the benchmark directory");
+
+    snprintf(bench_playlist_path, sizeof(bench_playlist_path), "%s/library.m3u", dir);
+    FILE* f = fopen(bench_playlist_path, "w");
+    assert(f != NULL && "Couldn't write the benchmark playlist");
+    fputs("#EXTM3U\n", f);
+    for (size_t i = 0; i < BENCH_PLAYLIST_LINES; ++i)
+        fprintf(f, "Artist %zu/Album %zu/%03zu - Some Track Name.mp3\n", i % 997, i % 13, i % 1000);
+    fclose(f);
+}
+
+// The whole import, from an empty playlist, including growing it
+static void bench_playlist_import(size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        free(plug->pl.songs);
+        plug->pl = (Playlist) {0};
+        const bool imported = plug_import_playlist(bench_playlist_path);
+        assert(imported && plug->pl.count == BENCH_PLAYLIST_LINES);
+    }
+}
+
+static void bench_playlist_teardown(void)
+{
+    unlink(bench_playlist_path);
+    rmdir(bench_playlist_dir);
+    bench_reset_plug();
+}
+
+static Fingerprint* bench_fp_queries;
+
+static float bench_randf(void)
+{
+    return (float) rand() / RAND_MAX;
+}
+
+// Chroma scattered around the 24 major and minor key profiles, so the buckets fill as unevenly
+// as with a real library, and durations of a few minutes
+static Fingerprint bench_fp_random(void)
+{
+    static const bool major[12] = {1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1};
+    static const bool minor[12] = {1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 0};
+    const size_t key = rand() % 24;
+
+    Fingerprint fp = { .duration = 120.f + bench_randf()*300.f, .count = BENCH_FP_FRAMES };
+    float norm = 0.f;
+    for (size_t c = 0; c < 12; ++c) {
+        const bool in_key = (key < 12 ? major : minor)[(c + 12 - key % 12) % 12];
+        fp.chroma[c] = (in_key ? 1.f : .3f) + bench_randf()*.4f;
+        norm += fp.chroma[c]*fp.chroma[c];
+    }
+    for (size_t c = 0; c < 12; ++c) fp.chroma[c] /= sqrtf(norm);
+
+    fp.frames = malloc(BENCH_FP_FRAMES*sizeof(*fp.frames));
+    assert(fp.frames != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < BENCH_FP_FRAMES; ++i) fp.frames[i] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+    return fp;
+}
+
+// Half the queries are re-encodes of indexed tracks (a few bits flipped per frame), the rest are new
+static void bench_fp_setup(void)
+{
+    bench_reset_plug();
+    for (size_t i = 0; i < BENCH_FP_TRACKS; ++i) {
+        Fingerprint fp = bench_fp_random();
+        fp.song_id = i + 1;
+        fp_index_insert(&plug->fp, fp);
+    }
+
+    bench_fp_queries = malloc(BENCH_FP_QUERIES*sizeof(*bench_fp_queries));
+    assert(bench_fp_queries != NULL && "Buy more RAM lol");
+    for (size_t q = 0; q < BENCH_FP_QUERIES; ++q) {
+        Fingerprint fp = bench_fp_random();
+        if (q % 2 == 0) {
+            const Fingerprint* original = &plug->fp.items[rand() % BENCH_FP_TRACKS];
+            fp.duration = original->duration;
+            memcpy(fp.chroma, original->chroma, sizeof(fp.chroma));
+            for (size_t i = 0; i < BENCH_FP_FRAMES; ++i)
+                fp.frames[i] = original->frames[i] ^ (1u << (rand() % 32)) ^ (1u << (rand() % 32));
+        }
+        bench_fp_queries[q] = fp;
+    }
+}
+
+static void bench_fp_lookup(size_t ops)
+{
+    size_t found = 0;
+    for (size_t i = 0; i < ops; ++i)
+        found += fp_index_lookup(&plug->fp, &bench_fp_queries[i % BENCH_FP_QUERIES]) != NULL;
+    bench_sink = found;
+}
+
+static void bench_fp_teardown(void)
+{
+    for (size_t q = 0; q < BENCH_FP_QUERIES; ++q) free(bench_fp_queries[q].frames);
+    free(bench_fp_queries);
+    bench_fp_queries = NULL;
+    fp_index_free(&plug->fp);
+    bench_reset_plug();
+}
+
+typedef struct {
+    const char* name;
+    bool playable;
+} Bench_Preflight_File;
+
+static const Bench_Preflight_File BENCH_PREFLIGHT_FILES[] = {
+    {"good.wav",       true},
+    {"tagged.mp3",     true},
+    {"empty.wav",      false},
+    {"empty.mp3",      false},
+    {"truncated.wav",  false},
+    {"truncated.mp3",  false},
+    {"garbage.ogg",    false},
+    {"garbage.mp3",    false},
+    {"garbage.qoa",    false},
+};
+
+static char bench_preflight_template[] = "/tmp/player-bench-preflight-XXXXXX";
+static char bench_preflight_dir[sizeof(bench_preflight_template)];
+
+static void bench_write_file(const char* name, const void* data, size_t size)
+{
+    char path[TEXT_CAP];
+    snprintf(path, sizeof(path), "%s/%s", bench_preflight_dir, name);
+    FILE* f = fopen(path, "wb");
+    assert(f != NULL && "Couldn't write a benchmark file");
+    fwrite(data, 1, size, f);
+    fclose(f);
+}
+
+// ID3v2.4 header for a tag of `size` bytes, not counting the header
+static void bench_id3v2_header(unsigned char* o, size_t size)
+{
+    const unsigned char header[10] = {'I', 'D', '3', 4, 0, 0, size >> 21 & 0x7F, size >> 14 & 0x7F, size >> 7 & 0x7F, size & 0x7F};
+    memcpy(o, header, sizeof(header));
+}
+
+// Good tracks next to empty, cut off and garbage ones: the setup runs the pre-flight jobs over
+// them as the player would, checks exactly the bad ones are skipped and that playing through
+// the playlist only ever lands on good ones. The runs time the checks themselves.
+static void bench_preflight_setup(void)
+{
+    bench_reset_plug();
+    strcpy(bench_preflight_dir, bench_preflight_template);
+    const char* dir = mkdtemp(bench_preflight_dir);
+    assert(dir != NULL && "Couldn't create the benchmark directory");
+
+    char path[TEXT_CAP];
+    const uint32_t frames = MODULE_RENDER_RATE*BENCH_TRACK_SECONDS;
+    short* samples = malloc(frames*2*sizeof(*samples));
+    assert(samples != NULL && "Buy more RAM lol");
+    for (uint32_t i = 0; i < frames*2; ++i) samples[i] = (short) (sinf(i*.01f)*8000);
+    snprintf(path, sizeof(path), "%s/good.wav", dir);
+    const Wave wave = { .frameCount = frames, .sampleRate = MODULE_RENDER_RATE, .sampleSize = 16, .channels = 2, .data = samples };
+    const bool written = ExportWave(wave, path);
+    assert(written && "Couldn't write the benchmark track");
+    free(samples);
+
+    int wav_size = 0;
+    unsigned char* wav = LoadFileData(path, &wav_size);
+    assert(wav != NULL && wav_size > 64);
+    bench_write_file("truncated.wav", wav, 40);
+    UnloadFileData(wav);
+
+    // MPEG-1 layer III frames at 128 kbps, 44.1 kHz, all zero side info: silence
+    const size_t frame_size = 417;
+    const size_t mp3_size = 10 + BENCH_PREFLIGHT_TAG_BYTES + BENCH_PREFLIGHT_MP3_FRAMES*frame_size;
+    unsigned char* mp3 = calloc(mp3_size, 1);
+    assert(mp3 != NULL && "Buy more RAM lol");
+    bench_id3v2_header(mp3, BENCH_PREFLIGHT_TAG_BYTES);
+    for (size_t i = 0; i < BENCH_PREFLIGHT_MP3_FRAMES; ++i)
+        memcpy(mp3 + 10 + BENCH_PREFLIGHT_TAG_BYTES + i*frame_size, "\xFF\xFB\x90\x64", 4);
+    bench_write_file("tagged.mp3", mp3, mp3_size);
+    bench_write_file("truncated.mp3", mp3, 10 + BENCH_PREFLIGHT_TAG_BYTES/2);
+    free(mp3);
+
+    bench_write_file("empty.wav", "", 0);
+    bench_write_file("empty.mp3", "", 0);
+
+    unsigned char garbage[64*1024];
+    for (size_t i = 0; i < sizeof(garbage); ++i) garbage[i] = rand();
+    garbage[0] = 0;
+    bench_write_file("garbage.ogg", garbage, sizeof(garbage));
+    bench_write_file("garbage.mp3", garbage, sizeof(garbage));
+    bench_write_file("garbage.qoa", garbage, sizeof(garbage));
+
+    for (size_t i = 0; i < DA_LEN(BENCH_PREFLIGHT_FILES); ++i) {
+        snprintf(path, sizeof(path), "%s/%s", dir, BENCH_PREFLIGHT_FILES[i].name);
+        DA_PUSH(plug->pl, new_song(path, 0));
+        plug->pl.songs[i].id = ++plug->pl.last_id;
+    }
+
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        Preflight_Job* job = calloc(1, sizeof(*job));
+        assert(job != NULL && "Buy more RAM lol");
+        job->song_id = plug->pl.songs[i].id;
+        job->song_hint = i;
+        strcpy(job->path, plug->pl.songs[i].path);
+        plug->pl.songs[i].check_state = CHECK_PENDING;
+        preflight_job_run(&job->job);
+        preflight_job_done(&job->job);
+    }
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        if (is_song_skipped(&plug->pl.songs[i]) == !BENCH_PREFLIGHT_FILES[i].playable) continue;
+        fprintf(stderr, "preflight_mixed: %s was %s\n", BENCH_PREFLIGHT_FILES[i].name,
+                BENCH_PREFLIGHT_FILES[i].playable ? "skipped" : "not skipped");
+        abort();
+    }
+
+    plug->pl.curr = 0;
+    for (size_t i = 0; i < 2*plug->pl.count; ++i) {
+        plug_next_song();
+        assert(plug->music_loaded && BENCH_PREFLIGHT_FILES[plug->pl.curr].playable && "Landed on a bad track");
+    }
+    plug_unload_music();
+}
+
+static void bench_preflight(size_t ops)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        const Bench_Preflight_File* file = &BENCH_PREFLIGHT_FILES[i % DA_LEN(BENCH_PREFLIGHT_FILES)];
+        const Song* song = &plug->pl.songs[i % DA_LEN(BENCH_PREFLIGHT_FILES)];
+        const bool playable = preflight_check(song->path) == NULL;
+        assert(playable == file->playable);
+    }
+}
+
+static void bench_preflight_teardown(void)
+{
+    for (size_t i = 0; i < plug->pl.count; ++i) unlink(plug->pl.songs[i].path);
+    rmdir(bench_preflight_dir);
+    bench_reset_plug();
+}
+
+static char bench_library_template[] = "/tmp/player-bench-library-XXXXXX";
+static char bench_library_dir[sizeof(bench_library_template)];
+static double* bench_library_made;  // When the writer made each change
+static _Atomic size_t bench_library_made_count;
+static bool bench_library_deleting;
+static pthread_mutex_t bench_library_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_library_cond = PTHREAD_COND_INITIALIZER;
+static double* bench_library_latency; // Change to visible in the playlist, of every run
+static size_t bench_library_latency_count;
+
+static void bench_library_setup(void)
+{
+    bench_reset_plug();
+    strcpy(bench_library_dir, bench_library_template);
+    const char* dir = mkdtemp(bench_library_dir);
+    assert(dir != NULL && "Couldn't create the benchmark directory");
+    plug_library_add(dir);
+    assert(plug->library.watching && "Couldn't watch the benchmark directory");
+
+    bench_library_made = malloc(BENCH_LIBRARY_CHANGES*sizeof(*bench_library_made));
+    bench_library_latency = malloc((BENCH_REPS + 1)*BENCH_LIBRARY_CHANGES*sizeof(*bench_library_latency));
+    assert(bench_library_made != NULL && bench_library_latency != NULL && "Buy more RAM lol");
+    bench_library_latency_count = 0;
+}
+
+// Creates half the files, waits for them to show up, then deletes them
+static void* bench_library_writer(void* arg)
+{
+    const size_t files = (size_t) arg / 2;
+    char path[TEXT_CAP];
+    for (size_t i = 0; i < files*2; ++i) {
+        snprintf(path, sizeof(path), "%s/%06zu.mp3", bench_library_dir, i % files);
+        if (i < files) {
+            const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            assert(fd >= 0 && "Couldn't write a benchmark file");
+            close(fd);
+        } else {
+            if (i == files) {
+                pthread_mutex_lock(&bench_library_lock);
+                while (!bench_library_deleting) pthread_cond_wait(&bench_library_cond, &bench_library_lock);
+                pthread_mutex_unlock(&bench_library_lock);
+            }
+            unlink(path);
+        }
+
+        bench_library_made[i] = monotonic_time();
+        atomic_store(&bench_library_made_count, i + 1);
+    }
+    return NULL;
+}
+
+// A storm of file changes on a watched directory, polled once a frame as the player does at 60 FPS.
+// ns/op is per change end to end, and the latency counts the wait for the frame that picks it up.
+static void bench_library_storm(size_t ops)
+{
+    assert(plug->pl.count == 0);
+    const size_t files = ops / 2;
+    atomic_store(&bench_library_made_count, 0);
+    bench_library_deleting = false;
+
+    pthread_t writer;
+    pthread_create(&writer, NULL, bench_library_writer, (void*) ops);
+
+    struct timespec frame;
+    clock_gettime(CLOCK_MONOTONIC, &frame);
+
+    size_t seen = 0;
+    bool deleting = false;
+    while (seen < files*2) {
+        frame.tv_nsec += (long) (BENCH_FRAME_SECONDS*1e9);
+        if (frame.tv_nsec >= 1000000000L) {
+            frame.tv_sec++;
+            frame.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &frame, NULL) == EINTR);
+
+        plug_library_poll();
+        const double now = monotonic_time();
+
+        const size_t visible = deleting ? files*2 - plug->pl.count : plug->pl.count;
+        for (; seen < visible; ++seen) {
+            // The change can show up before the writer got to note the time it made it
+            while (atomic_load(&bench_library_made_count) <= seen) sched_yield();
+            bench_library_latency[bench_library_latency_count++] = now - bench_library_made[seen];
+        }
+
+        if (!deleting && seen == files) {
+            deleting = true;
+            pthread_mutex_lock(&bench_library_lock);
+            bench_library_deleting = true;
+            pthread_cond_signal(&bench_library_cond);
+            pthread_mutex_unlock(&bench_library_lock);
+        }
+    }
+
+    pthread_join(writer, NULL);
+}
+
+static void bench_library_teardown(void)
+{
+    const Library* lib = &plug->library;
+    qsort(bench_library_latency, bench_library_latency_count, sizeof(*bench_library_latency), compare_doubles);
+    const size_t n = bench_library_latency_count;
+    fprintf(stderr, "library_storm: change to visible at %.0f FPS p50 %.0f us, p99 %.0f us, max %.0f us; "
+            "%.0f ns CPU per event, worst batch %.2f ms, %zu overflows\n",
+            1/BENCH_FRAME_SECONDS, bench_library_latency[n/2]*1e6, bench_library_latency[MIN(n*99/100, n - 1)]*1e6, bench_library_latency[n - 1]*1e6,
+            lib->cpu_time*1e9 / MAX(lib->events, 1), lib->worst_batch*1e3, lib->overflows);
+
+    plug_library_close();
+    rmdir(bench_library_dir);
+    free(bench_library_made);
+    free(bench_library_latency);
+    bench_reset_plug();
+}
+
+#ifdef TRANSCODE_QOA
+static char bench_decode_template[] = "/tmp/player-bench-decode-XXXXXX";
+static char bench_decode_dir[sizeof(bench_decode_template)];
+static char bench_decode_source[TEXT_CAP];
+static char bench_decode_qoa[TEXT_CAP];
+
+// A whole track decoded from the source and from its QOA copy, which is the decode CPU the
+// transcode cache saves. Point BENCH_DECODE_FILE at an mp3 or ogg, a generated WAV otherwise.
+static void bench_decode_setup(void)
+{
+    strcpy(bench_decode_dir, bench_decode_template);
+    const char* dir = mkdtemp(bench_decode_dir);
+    assert(dir != NULL && "Couldn't create the benchmark directory");
+
+    const char* source = getenv(BENCH_DECODE_ENV);
+    if (source && *source) snprintf(bench_decode_source, sizeof(bench_decode_source), "%s", source);
+    else {
+        const uint32_t frames = MODULE_RENDER_RATE*BENCH_DECODE_SECONDS;
+        short* samples = malloc(frames*2*sizeof(*samples));
+        assert(samples != NULL && "Buy more RAM lol");
+        for (uint32_t i = 0; i < frames*2; ++i) samples[i] = (short) (sinf(i*.01f)*8000);
+
+        snprintf(bench_decode_source, sizeof(bench_decode_source), "%s/source.wav", dir);
+        const Wave wave = { .frameCount = frames, .sampleRate = MODULE_RENDER_RATE, .sampleSize = 16, .channels = 2, .data = samples };
+        const bool written = ExportWave(wave, bench_decode_source);
+        assert(written && "Couldn't write the benchmark track");
+        free(samples);
+    }
+
+    snprintf(bench_decode_qoa, sizeof(bench_decode_qoa), "%s/copy.qoa", dir);
+    const bool transcoded = transcode_to_qoa(bench_decode_source, bench_decode_qoa, NULL);
+    assert(transcoded && "Couldn't transcode the benchmark track");
+}
+
+static void bench_decode_teardown(void)
+{
+    if (strncmp(bench_decode_source, bench_decode_dir, strlen(bench_decode_dir)) == 0) unlink(bench_decode_source);
+    unlink(bench_decode_qoa);
+    rmdir(bench_decode_dir);
+}
+
+static void bench_decode(size_t ops, const char* path)
+{
+    for (size_t i = 0; i < ops; ++i) {
+        Wave wave = LoadWave(path);
+        bench_sink = wave.frameCount;
+        UnloadWave(wave);
+    }
+}
+
+static void bench_decode_source_run(size_t ops) { bench_decode(ops, bench_decode_source); }
+static void bench_decode_qoa_run(size_t ops) { bench_decode(ops, bench_decode_qoa); }
+
+#ifdef STREAM_DECODE
+// The source track streamed the way music is played: through the stdio readers raylib's
+// LoadMusicStream() opens files with, and out of the copy in memory the player now uses.
+// Besides the time, the read syscalls, page faults and CPU per second of audio go to stderr.
+typedef struct {
+    double audio_seconds;
+    double cpu_time;
+    size_t syscalls;
+    size_t faults;
+} Bench_Reader_Stats;
+
+static Bench_Reader_Stats bench_reader_stats;
+static short bench_reader_chunk[DECODER_CHUNK_FRAMES*DECODER_MAX_CHANNELS];
+
+// Read syscalls of the process so far, including the ones reading this
+static size_t bench_read_syscalls(void)
+{
+    FILE* f = fopen("/proc/self/io", "r");
+    if (!f) return 0;
+
+    char line[128];
+    size_t syscr = 0;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "syscr: %zu", &syscr) == 1) break;
+    fclose(f);
+    return syscr;
+}
+
+static size_t bench_page_faults(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+static void bench_reader_setup(void)
+{
+    bench_decode_setup();
+    memset(&bench_reader_stats, 0, sizeof(bench_reader_stats));
+}
+
+static void bench_reader_report(const char* name)
+{
+    const Bench_Reader_Stats* s = &bench_reader_stats;
+    fprintf(stderr, "%s: %.1f read syscalls, %.1f page faults, %.3f ms CPU per second of audio\n", name,
+            s->syscalls / s->audio_seconds, s->faults / s->audio_seconds, s->cpu_time*1e3 / s->audio_seconds);
+}
+
+static void bench_reader_stdio_teardown(void)
+{
+    bench_reader_report("read_stdio");
+    bench_decode_teardown();
+}
+
+static void bench_reader_memory_teardown(void)
+{
+    bench_reader_report("read_memory");
+    bench_decode_teardown();
+}
+
+// Out of `data` when there is one, otherwise from the file
+static size_t bench_reader_decode(const char* path, const Music_Data* data, unsigned int* sample_rate)
+{
+    const char* ext = GetFileExtension(path);
+    size_t frames = 0;
+    if (strcasecmp(ext, ".wav") == 0) {
+        drwav wav;
+        if (!(data ? drwav_init_memory(&wav, data->data, data->size, NULL) : drwav_init_file(&wav, path, NULL))) return 0;
+        for (size_t n; (n = drwav_read_pcm_frames_s16(&wav, DECODER_CHUNK_FRAMES, bench_reader_chunk)) > 0;) frames += n;
+        *sample_rate = wav.sampleRate;
+        drwav_uninit(&wav);
+    } else if (strcasecmp(ext, ".mp3") == 0) {
+        drmp3* mp3 = malloc(sizeof(*mp3));
+        assert(mp3 != NULL && "Buy more RAM lol");
+        if (data ? drmp3_init_memory(mp3, data->data, data->size, NULL) : drmp3_init_file(mp3, path, NULL)) {
+            for (size_t n; (n = drmp3_read_pcm_frames_s16(mp3, DECODER_CHUNK_FRAMES, bench_reader_chunk)) > 0;) frames += n;
+            *sample_rate = mp3->sampleRate;
+            drmp3_uninit(mp3);
+        }
+        free(mp3);
+    } else if (strcasecmp(ext, ".ogg") == 0) {
+        stb_vorbis* ogg = data
+            ? stb_vorbis_open_memory(data->data, data->size, NULL, NULL)
+            : stb_vorbis_open_filename(path, NULL, NULL);
+        if (!ogg) return 0;
+        const stb_vorbis_info info = stb_vorbis_get_info(ogg);
+        const int len = DECODER_CHUNK_FRAMES*info.channels;
+        for (int n; (n = stb_vorbis_get_samples_short_interleaved(ogg, info.channels, bench_reader_chunk, len)) > 0;) frames += n;
+        *sample_rate = info.sample_rate;
+        stb_vorbis_close(ogg);
+    }
+    return frames;
+}
+
+static size_t bench_reader_stdio_decode(const char* path, unsigned int* sample_rate)
+{
+    return bench_reader_decode(path, NULL, sample_rate);
+}
+
+static size_t bench_reader_memory_decode(const char* path, unsigned int* sample_rate)
+{
+    Music_Data data = {0};
+    if (!music_data_open(path, &data)) return 0;
+
+    const size_t frames = bench_reader_decode(path, &data, sample_rate);
+    music_data_close(&data);
+    return frames;
+}
+
+static void bench_reader(size_t ops, const char* path, size_t (*decode)(const char*, unsigned int*))
+{
+    for (size_t i = 0; i < ops; ++i) {
+        const size_t syscalls = bench_read_syscalls();
+        const size_t faults = bench_page_faults();
+        const double cpu = thread_cpu_time();
+
+        unsigned int sample_rate = 0;
+        const size_t frames = decode(path, &sample_rate);
+        assert(frames > 0 && "Couldn't decode the benchmark track");
+
+        bench_reader_stats.cpu_time += thread_cpu_time() - cpu;
+        bench_reader_stats.faults += bench_page_faults() - faults;
+        // Less the read() of /proc/self/io before decoding
+        bench_reader_stats.syscalls += bench_read_syscalls() - syscalls - 1;
+        bench_reader_stats.audio_seconds += (double) frames / sample_rate;
+    }
+}
+
+static void bench_reader_stdio_run(size_t ops) { bench_reader(ops, bench_decode_source, bench_reader_stdio_decode); }
+static void bench_reader_memory_run(size_t ops) { bench_reader(ops, bench_decode_source, bench_reader_memory_decode); }
+
+#ifdef PRERENDER_MODULES
+static char bench_module_path[TEXT_CAP];
+static char bench_module_rendered[TEXT_CAP];
+
+// Four channel ProTracker module: a looped sine sample running up and down a scale on every
+// channel, BENCH_MODULE_PATTERNS patterns of 64 rows at the default speed (~7.7 s each)
+static bool bench_module_write(const char* path)
+{
+    static const uint16_t periods[] = {428, 381, 339, 320, 285, 254, 226, 214};
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    unsigned char header[1084] = "player bench";
+    unsigned char* sample = header + 20;
+    memcpy(sample, "sine", 4);
+    sample[22] = BENCH_MODULE_SAMPLE_LEN/2 >> 8; sample[23] = BENCH_MODULE_SAMPLE_LEN/2 & 0xFF;
+    sample[25] = 64;
+    sample[28] = BENCH_MODULE_SAMPLE_LEN/2 >> 8; sample[29] = BENCH_MODULE_SAMPLE_LEN/2 & 0xFF;
+    header[950] = BENCH_MODULE_PATTERNS;
+    header[951] = 127;
+    for (size_t i = 0; i < BENCH_MODULE_PATTERNS; ++i) header[952 + i] = i % 2;
+    memcpy(header + 1080, "M.K.", 4);
+    fwrite(header, 1, sizeof(header), f);
+
+    for (size_t pattern = 0; pattern < 2; ++pattern) {
+        for (size_t row = 0; row < 64; ++row) {
+            for (size_t channel = 0; channel < 4; ++channel) {
+                const uint16_t period = periods[(row + channel*2 + pattern*3) % DA_LEN(periods)];
+                const unsigned char note[4] = { period >> 8, period & 0xFF, 1 << 4, 0 };
+                fwrite(note, 1, sizeof(note), f);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < BENCH_MODULE_SAMPLE_LEN; ++i) fputc((signed char) (sinf(2*PI*i / BENCH_MODULE_SAMPLE_LEN)*100), f);
+
+    const bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+// The module played live through the renderer raylib's music stream refills from, against its
+// rendered copy read back through the mapped decoder, which is what the render cache trades for
+static void bench_module_setup(void)
+{
+    bench_reset_plug();
+    strcpy(bench_decode_dir, bench_decode_template);
+    const char* dir = mkdtemp(bench_decode_dir);
+    assert(dir != NULL && "Couldn't create the benchmark directory");
+
+    snprintf(bench_module_path, sizeof(bench_module_path), "%s/bench.mod", dir);
+    snprintf(bench_module_rendered, sizeof(bench_module_rendered), "%s/bench.wav", dir);
+    const bool written = bench_module_write(bench_module_path);
+    assert(written && "Couldn't write the benchmark module");
+
+    Module_Render_Job job = {0};
+    strcpy(job.path, bench_module_path);
+    strcpy(job.out_path, bench_module_rendered);
+    module_render_job_run(&job.job);
+    assert(job.ok && "Couldn't render the benchmark module");
+
+    memset(&bench_reader_stats, 0, sizeof(bench_reader_stats));
+}
+
+static void bench_module_teardown(void)
+{
+    unlink(bench_module_path);
+    unlink(bench_module_rendered);
+    rmdir(bench_decode_dir);
+}
+
+static void bench_mod_live_teardown(void)
+{
+    bench_reader_report("module_live");
+    bench_module_teardown();
+}
+
+static void bench_mod_cached_teardown(void)
+{
+    bench_reader_report("module_prerendered");
+    bench_module_teardown();
+}
+
+static size_t bench_module_live_decode(const char* path, unsigned int* sample_rate)
+{
+    jar_mod_context_t ctx;
+    jar_mod_init(&ctx);
+    jar_mod_setcfg(&ctx, MODULE_RENDER_RATE, 16, 1, 1, 0);
+
+    size_t frames = 0;
+    if (jar_mod_load_file(&ctx, path) > 0) {
+        const size_t total = jar_mod_max_samples(&ctx);
+        while (frames < total) {
+            const size_t n = MIN(total - frames, DECODER_CHUNK_FRAMES);
+            jar_mod_fillbuffer(&ctx, bench_reader_chunk, n, NULL);
+            frames += n;
+        }
+    }
+    jar_mod_unload(&ctx);
+
+    *sample_rate = MODULE_RENDER_RATE;
+    return frames;
+}
+
+static void bench_mod_live_run(size_t ops) { bench_reader(ops, bench_module_path, bench_module_live_decode); }
+static void bench_mod_cached_run(size_t ops) { bench_reader(ops, bench_module_rendered, bench_reader_memory_decode); }
+#endif
+#endif
+#endif
+
+static const Bench BENCHES[] = {
+    {"da_push",             NULL,                       bench_da_push,           NULL,                         BENCH_SONGS,           bench_reset_plug},
+    {"pull_next_shuffle",   bench_shuffle_setup,        bench_pull_next_shuffle, NULL,                         100000,                NULL},
+    {"pull_prev_shuffle",   bench_shuffle_setup,        bench_pull_prev_shuffle, NULL,                         100000,                NULL},
+    {"is_music",            bench_paths_setup,          bench_is_music,          bench_paths_teardown,         BENCH_PATHS,           NULL},
+    {"get_song_name",       bench_paths_setup,          bench_get_song_name,     bench_paths_teardown,         BENCH_PATHS,           NULL},
+    {"track_switch",        bench_track_switch_setup,   bench_track_switch,      bench_track_switch_teardown,  32,                    NULL},
+    {"truncate_playing",    bench_track_switch_setup,   bench_truncate_playing,  bench_track_switch_teardown,  32,                    NULL},
+    {"time_stretch_x0.50",  bench_stretch_setup,        bench_stretch_x050,      bench_stretch_teardown,       200,                   NULL},
+    {"time_stretch_x1.00",  bench_stretch_setup,        bench_stretch_x100,      bench_stretch_teardown,       200,                   NULL},
+    {"time_stretch_x2.00",  bench_stretch_setup,        bench_stretch_x200,      bench_stretch_teardown,       200,                   NULL},
+    {"time_stretch_x3.00",  bench_stretch_setup,        bench_stretch_x300,      bench_stretch_teardown,       200,                   NULL},
+    {"time_stretch_switch", bench_stretch_switch_setup, bench_stretch_switch,    bench_stretch_teardown,       200,                   NULL},
+    {"playlist_import_1m",  bench_playlist_setup,       bench_playlist_import,   bench_playlist_teardown,      1,                     NULL},
+    {"preflight_mixed",     bench_preflight_setup,      bench_preflight,         bench_preflight_teardown,     90,                    NULL},
+    {"fp_index_lookup",     bench_fp_setup,             bench_fp_lookup,         bench_fp_teardown,            BENCH_FP_QUERIES,      NULL},
+    {"library_storm",       bench_library_setup,        bench_library_storm,     bench_library_teardown,       BENCH_LIBRARY_CHANGES, NULL},
+#ifdef TRANSCODE_QOA
+    {"decode_source",       bench_decode_setup,         bench_decode_source_run, bench_decode_teardown,        1,                     NULL},
+    {"decode_qoa",          bench_decode_setup,         bench_decode_qoa_run,    bench_decode_teardown,        1,                     NULL},
+#endif
+#ifdef STREAM_DECODE
+    {"read_stdio",          bench_reader_setup,         bench_reader_stdio_run,  bench_reader_stdio_teardown,  1,                     NULL},
+    {"read_memory",         bench_reader_setup,         bench_reader_memory_run, bench_reader_memory_teardown, 1,                     NULL},
+#endif
+#if defined(STREAM_DECODE) && defined(PRERENDER_MODULES)
+    {"module_live",         bench_module_setup,         bench_mod_live_run,      bench_mod_live_teardown,      1,                     NULL},
+    {"module_prerendered",  bench_module_setup,         bench_mod_cached_run,    bench_mod_cached_teardown,    1,                     NULL},
+#endif
+};
+
+static double median(double* xs, size_t n)
+{
+    qsort(xs, n, sizeof(*xs), compare_doubles);
+    return n % 2 ? xs[n/2] : (xs[n/2 - 1] + xs[n/2]) / 2;
+}
+
+static Bench_Result bench_run(const Bench* bench)
+{
+    double ns[BENCH_REPS];
+
+    if (bench->setup) bench->setup();
+    if (bench->reset) bench->reset();
+    bench->run(bench->ops); // Warm up caches and the allocator
+
+    for (size_t r = 0; r < BENCH_REPS; ++r) {
+        if (bench->reset) bench->reset();
+        const double start = monotonic_time();
+        bench->run(bench->ops);
+        ns[r] = (monotonic_time() - start)*1e9 / bench->ops;
+    }
+
+    if (bench->teardown) bench->teardown();
+
+    Bench_Result result = { .ops = bench->ops };
+    snprintf(result.name, sizeof(result.name), "%s", bench->name);
+    result.median = median(ns, BENCH_REPS);
+    for (size_t r = 0; r < BENCH_REPS; ++r) ns[r] = fabs(ns[r] - result.median);
+    result.mad = median(ns, BENCH_REPS);
+    return result;
+}
+
+static void result_write(FILE* f, const Bench_Result* r)
+{
+    fprintf(f, "%s\t%.2f\t%.2f\t%zu\n", r->name, r->median, r->mad, r->ops);
+}
+
+static bool results_read(const char* path, Bench_Results* results)
+{
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+
+    char line[256];
+    while (results->count < BENCH_RESULTS_CAP && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        Bench_Result* r = &results->items[results->count];
+        if (sscanf(line, "%63s %lf %lf %zu", r->name, &r->median, &r->mad, &r->ops) == 4) results->count++;
+    }
+
+    fclose(f);
+    return true;
+}
+
+static const Bench_Result* results_find(const Bench_Results* results, const char* name)
+{
+    for (size_t i = 0; i < results->count; ++i)
+        if (strcmp(results->items[i].name, name) == 0) return &results->items[i];
+    return NULL;
+}
+
+// The allowed slowdown widens with the spread of both runs, so a noisy benchmark
+// doesn't fail on jitter alone. MAD*1.4826 estimates the standard deviation.
+static double allowed_slowdown(const Bench_Result* base, const Bench_Result* curr, double tolerance)
+{
+    const double noise = BENCH_NOISE_SIGMAS*1.4826*(base->mad / base->median + curr->mad / curr->median);
+    return MAX(tolerance, noise);
+}
+
+static bool is_regression(const Bench_Result* base, const Bench_Result* curr, double tolerance)
+{
+    return base && (curr->median - base->median) / base->median > allowed_slowdown(base, curr, tolerance);
+}
+
+static bool results_compare(const Bench_Results* base, const Bench_Results* curr, double tolerance)
+{
+    bool ok = true;
+
+    fprintf(stderr, "%-20s %12s %12s %8s %8s\n", "benchmark", "base ns/op", "ns/op", "delta", "allowed");
+    for (size_t i = 0; i < curr->count; ++i) {
+        const Bench_Result* c = &curr->items[i];
+        const Bench_Result* b = results_find(base, c->name);
+        if (!b) {
+            fprintf(stderr, "%-20s %12s %12.2f %8s %8s  new\n", c->name, "-", c->median, "-", "-");
+            continue;
+        }
+
+        const double delta = (c->median - b->median) / b->median;
+        const double allowed = allowed_slowdown(b, c, tolerance);
+        const bool regressed = is_regression(b, c, tolerance);
+        ok = ok && !regressed;
+
+        fprintf(stderr, "%-20s %12.2f %12.2f %+7.1f%% %7.1f%%  %s\n", c->name, b->median, c->median,
+                delta*100, allowed*100, regressed ? "REGRESSION" : delta < -allowed ? "faster" : "ok");
+    }
+
+    return ok;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [-o results.tsv] [-b baseline.tsv] [-t tolerance] [filter]\n", program);
+}
+
+int main(int argc, char** argv)
+{
+    const char* out_path = NULL;
+    const char* baseline_path = NULL;
+    double tolerance = BENCH_DEFAULT_TOLERANCE;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:b:t:h")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'b': baseline_path = optarg; break;
+        case 't': tolerance = strtod(optarg, NULL); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    const char* filter = optind < argc ? argv[optind] : NULL;
+
+    Bench_Results baseline = {0};
+    const bool have_baseline = baseline_path && results_read(baseline_path, &baseline);
+    if (baseline_path && !have_baseline)
+        fprintf(stderr, "No baseline at %s, record one with `make bench-baseline`\n", baseline_path);
+
+    SetTraceLogLevel(LOG_NONE);
+    plug = calloc(1, sizeof(*plug));
+    assert(plug != NULL && "Buy more RAM lol");
+    bench_reset_plug();
+
+    Bench_Results results = {0};
+    for (size_t i = 0; i < DA_LEN(BENCHES); ++i) {
+        if (filter && !strstr(BENCHES[i].name, filter)) continue;
+        Bench_Result* result = &results.items[results.count];
+        *result = bench_run(&BENCHES[i]);
+
+        // A one-off hiccup of the machine shouldn't fail the run, a regression has to reproduce
+        const Bench_Result* base = have_baseline ? results_find(&baseline, result->name) : NULL;
+        for (size_t retry = 0; retry < BENCH_RETRIES && is_regression(base, result, tolerance); ++retry) {
+            const Bench_Result again = bench_run(&BENCHES[i]);
+            if (again.median < result->median) *result = again;
+        }
+
+        result_write(stdout, &results.items[results.count++]);
+        fflush(stdout);
+    }
+
+    if (out_path) {
+        FILE* f = fopen(out_path, "w");
+        if (!f) {
+            fprintf(stderr, "ERROR: could not write %s: %s\n", out_path, strerror(errno));
+            return 1;
+        }
+        fprintf(f, "# name\tmedian_ns\tmad_ns\tops\n");
+        for (size_t i = 0; i < results.count; ++i) result_write(f, &results.items[i]);
+        fclose(f);
+    }
+
+    const bool ok = !have_baseline || results_compare(&baseline, &results, tolerance);
+
+    free(plug->pl.songs);
+    free(plug);
+    return ok ? 0 : 1;
+}
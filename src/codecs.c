@@ -0,0 +1,10 @@
+// The implementations behind codecs.h, in a translation unit of their own so plug.c keeps
+// its warnings. Built with hidden visibility (see the Makefile), so the plug neither exports
+// them nor binds to the copies inside libraylib.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CODECS_IMPLEMENTATION
+#include "codecs.h"
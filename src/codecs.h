@@ -0,0 +1,48 @@
+#ifndef CODECS_H
+#define CODECS_H
+
+// raylib's single header decoders, QOA codec and tracker module renderers, taken from its
+// sources when they're around (see RAYLIB_SRC in the Makefile). Their code is compiled in by
+// codecs.c from these same headers, so the structs plug.c allocates always match the code
+// filling them, whatever version libraylib was built from.
+
+#if defined(__has_include)
+#   if __has_include("external/jar_xm.h") && __has_include("external/jar_mod.h")
+#       define PRERENDER_MODULES
+#   endif
+#   if __has_include("external/dr_wav.h") && __has_include("external/dr_mp3.h") \
+    && __has_include("external/stb_vorbis.c") && __has_include("external/qoa.h")
+#       define STREAM_DECODE
+#   endif
+#endif
+
+#ifdef CODECS_IMPLEMENTATION
+#   define JAR_XM_IMPLEMENTATION
+#   define JAR_MOD_IMPLEMENTATION
+#   define DR_WAV_IMPLEMENTATION
+#   define DR_MP3_IMPLEMENTATION
+#   define QOA_IMPLEMENTATION
+#else
+#   define STB_VORBIS_HEADER_ONLY
+#endif
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wall"
+#pragma GCC diagnostic ignored "-Wextra"
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#ifdef PRERENDER_MODULES
+#   include "external/jar_xm.h"
+#   include "external/jar_mod.h"
+#endif
+
+#ifdef STREAM_DECODE
+#   include "external/dr_wav.h"
+#   include "external/dr_mp3.h"
+#   include "external/stb_vorbis.c"
+#   include "external/qoa.h"
+#endif
+
+#pragma GCC diagnostic pop
+
+#endif // CODECS_H
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "plug.h"
+
+#define LINE_CAP 4096
+#define BENCH_DEFAULT_BATCH 1000
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static struct sockaddr_un addr;
+
+static int ctl_connect(void)
+{
+    if (!ctl_socket_addr(&addr)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool write_all(int fd, const char* buf, size_t n)
+{
+    while (n > 0) {
+        const ssize_t w = write(fd, buf, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        buf += w;
+        n -= w;
+    }
+    return true;
+}
+
+// Prints every reply line until `until` is seen (or until nothing is pending if `until` is NULL)
+static bool read_replies(int fd, const char* until, bool print)
+{
+    static char buf[LINE_CAP];
+    static size_t len = 0;
+
+    for (;;) {
+        char* nl;
+        while ((nl = memchr(buf, '\n', len)) != NULL) {
+            *nl = '\0';
+            const bool done = until && strcmp(buf, until) == 0;
+            if (print && !done) printf("%s\n", buf);
+            len -= nl + 1 - buf;
+            memmove(buf, nl + 1, len);
+            if (done) return true;
+        }
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, until ? -1 : 0) <= 0) return until == NULL;
+
+        const ssize_t n = read(fd, buf + len, sizeof(buf) - len);
+        if (n <= 0) return false;
+        len += n;
+    }
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    const double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+// Sends `total` commands in batches, each terminated by a ping, and times the round trips
+static int bench(int fd, size_t total, size_t batch, const char* cmd)
+{
+    const size_t cmd_len = strlen(cmd);
+    const size_t batches = (total + batch - 1) / batch;
+
+    char* buf = malloc(batch*(cmd_len + 1) + sizeof("ping\n"));
+    double* lat = malloc(batches*sizeof(*lat));
+    if (!buf || !lat) return 1;
+
+    const double start = now();
+    for (size_t b = 0, sent = 0; b < batches; ++b) {
+        const size_t n = MIN(batch, total - sent);
+        size_t len = 0;
+        for (size_t i = 0; i < n; ++i) {
+            memcpy(buf + len, cmd, cmd_len);
+            buf[len + cmd_len] = '\n';
+            len += cmd_len + 1;
+        }
+        memcpy(buf + len, "ping\n", 5);
+        len += 5;
+
+        const double t = now();
+        if (!write_all(fd, buf, len) || !read_replies(fd, "pong", false)) {
+            fprintf(stderr, "ERROR: connection lost after %zu commands\n", sent);
+            return 1;
+        }
+        lat[b] = now() - t;
+        sent += n;
+    }
+    const double elapsed = now() - start;
+
+    qsort(lat, batches, sizeof(*lat), cmp_double);
+    printf("commands: %zu, batch: %zu, elapsed: %.3f s\n", total, batch, elapsed);
+    printf("throughput: %.0f commands/s\n", total / elapsed);
+    printf("enqueue latency per batch: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           lat[batches/2]*1e3, lat[batches*99/100]*1e3, lat[batches - 1]*1e3);
+    printf("enqueue latency per command: %.3f us\n", lat[batches/2]*1e6 / batch);
+
+    free(buf);
+    free(lat);
+    return 0;
+}
+
+// Space separated, -1 if they don't fit in `n` bytes with the terminator
+static int join_args(char* o, size_t n, int argc, char** argv)
+{
+    size_t len = 0;
+    for (int i = 0; i < argc; ++i) {
+        const int w = snprintf(o + len, n - len, i > 0 ? " %s" : "%s", argv[i]);
+        if (w < 0 || (size_t) w >= n - len) return -1;
+        len += w;
+    }
+    return len;
+}
+
+// The player runs somewhere else, so paths are sent absolute. `export` may name a file
+// that isn't there yet, its directory has to be.
+static bool resolve_path(const char* cmd, const char* path, char* o)
+{
+    if (realpath(path, o)) return true;
+    if (errno != ENOENT || strcmp(cmd, "export") != 0) return false;
+
+    char dir[PATH_MAX];
+    if (snprintf(dir, sizeof(dir), "%s", path) >= (int) sizeof(dir)) return false;
+    char* slash = strrchr(dir, '/');
+    const char* name = slash ? path + (slash - dir) + 1 : path;
+    if (!slash) strcpy(dir, ".");
+    else if (slash == dir) dir[1] = '\0';
+    else *slash = '\0';
+
+    if (!realpath(dir, o)) return false;
+    const size_t len = strlen(o);
+    return snprintf(o + len, PATH_MAX - len, "%s%s", len > 1 ? "/" : "", name) < (int) (PATH_MAX - len);
+}
+
+// Rewrites the path argument of add, import and export in place, false if it can't be resolved
+static bool resolve_command(char* line, size_t n)
+{
+    char* arg = strchr(line, ' ');
+    if (!arg) return true;
+
+    const size_t cmd_len = arg - line;
+    char cmd[8] = {0};
+    if (cmd_len >= sizeof(cmd)) return true;
+    memcpy(cmd, line, cmd_len);
+    if (strcmp(cmd, "add") != 0 && strcmp(cmd, "import") != 0 && strcmp(cmd, "export") != 0) return true;
+
+    char resolved[PATH_MAX];
+    if (!resolve_path(cmd, arg + 1, resolved)) {
+        fprintf(stderr, "ERROR: %s: %s\n", arg + 1, strerror(errno));
+        return false;
+    }
+    if (snprintf(arg + 1, n - cmd_len - 1, "%s", resolved) >= (int) (n - cmd_len - 1)) {
+        fprintf(stderr, "ERROR: %s is longer than %zu bytes\n", resolved, n - cmd_len - 2);
+        return false;
+    }
+    return true;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [command...]\n", program);
+    fprintf(stderr, "       %s bench <count> [batch] [command...]\n", program);
+    fprintf(stderr, "Without a command, newline separated commands are read from stdin.\n");
+    fprintf(stderr, "Commands: add <path>, play, pause, next, prev, seek <secs>, volume <0..1>, nop, ping, state\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        usage(argv[0]);
+        return 0;
+    }
+
+    const int fd = ctl_connect();
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: could not connect to %s: %s\n", addr.sun_path, strerror(errno));
+        return 1;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "bench") == 0) {
+        const size_t total = strtoull(argv[2], NULL, 10);
+        const size_t batch = argc > 3 ? strtoull(argv[3], NULL, 10) : BENCH_DEFAULT_BATCH;
+        if (total == 0 || batch == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        char cmd[LINE_CAP] = "nop";
+        if (argc > 4 && join_args(cmd, sizeof(cmd), argc - 4, argv + 4) < 0) {
+            fprintf(stderr, "ERROR: command is longer than %d bytes\n", LINE_CAP - 1);
+            return 1;
+        }
+
+        const int ret = bench(fd, total, batch, cmd);
+        close(fd);
+        return ret;
+    }
+
+    if (argc > 1) {
+        // One byte kept for the newline
+        char line[LINE_CAP];
+        int len = join_args(line, sizeof(line) - 1, argc - 1, argv + 1);
+        if (len < 0) {
+            fprintf(stderr, "ERROR: command is longer than %d bytes\n", LINE_CAP - 2);
+            return 1;
+        }
+        if (!resolve_command(line, sizeof(line) - 1)) return 1;
+        len = strlen(line);
+        line[len++] = '\n';
+        if (!write_all(fd, line, len)) return 1;
+    } else {
+        char line[LINE_CAP];
+        while (fgets(line, sizeof(line), stdin)) {
+            line[strcspn(line, "\n")] = '\0';
+            if (!resolve_command(line, sizeof(line) - 1)) continue;
+            const size_t len = strlen(line);
+            line[len] = '\n';
+            if (!write_all(fd, line, len + 1)) return 1;
+            read_replies(fd, NULL, true);
+        }
+    }
+
+    // Flush the server side and collect whatever replies are still in flight
+    if (!write_all(fd, "ping\n", 5) || !read_replies(fd, "pong", true)) return 1;
+
+    close(fd);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <time.h>
 #include <dlfcn.h>
@@ -15,6 +16,7 @@ FN(plug_free);
 FN(plug_frame);
 FN(plug_pre_reload);
 FN(plug_post_reload);
+FN(plug_input_record);
 
 bool plug_reload(void)
 {
@@ -32,14 +34,22 @@ bool plug_reload(void)
     FN_SYM(plug_frame, libplug, return false);
     FN_SYM(plug_pre_reload, libplug, return false);
     FN_SYM(plug_post_reload, libplug, return false);
+    FN_SYM(plug_input_record, libplug, return false);
     
     TraceLog(LOG_INFO, "Reloaded libplug successfully");
 
     return true;
 }
 
-int main(void)
+int main(int argc, char** argv)
 {
+    const char* record_path = NULL;
+    if (argc == 3 && strcmp(argv[1], "--record") == 0) record_path = argv[2];
+    else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--record <input.log>]\n", argv[0]);
+        return 1;
+    }
+
     SetTargetFPS(60);
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
 
@@ -52,7 +62,9 @@ int main(void)
     if (!plug_reload()) return 1;
     plug_init();
 
-    srand(time(NULL));
+    const unsigned int seed = time(NULL);
+    srand(seed);
+    if (record_path && !plug_input_record(record_path, seed)) return 1;
 
     for (; !WindowShouldClose(); plug_frame()) {
         if (IsKeyPressed(KEY_R)) {
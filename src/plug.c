@@ -1,12 +1,47 @@
+#define _GNU_SOURCE // SCHED_IDLE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <assert.h>
+#include <math.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
 
 #include <raylib.h>
 
 #include "plug.h"
 
+#if defined(__SSE__)
+#   include <xmmintrin.h>
+#endif
+
+// Tracker modules are rendered ahead with the same renderers raylib plays them with, and
+// background jobs decode a chunk at a time with raylib's own decoders instead of LoadWave()'ing
+// the whole file
+#include "codecs.h"
+
+// Tracks are transcoded with that same QOA encoder, through those decoders
+#ifdef STREAM_DECODE
+#   define TRANSCODE_QOA
+#endif
+
 #ifdef _WIN32
 #   define DELIM '\\'
 #else
@@ -20,6 +55,10 @@
 #define DEFAULT_MUSIC_VOLUME .3
 #define DEFAULT_MUSIC_SEEK_STEP 5.f
 #define DEFAULT_MUSIC_VOLUME_STEP .1
+#define DEFAULT_MUSIC_SPEED_STEP .25f
+
+#define MIN_MUSIC_SPEED .5f
+#define MAX_MUSIC_SPEED 3.f
 
 #define POPUP_MSG_DURATION 0.5
 
@@ -27,6 +66,62 @@
 #define DA_INIT_CAP 256
 #define SUPPORTED_FORMATS_CAP 6
 
+#define PLAYLIST_IMPORT_THREADS_CAP 16
+#define EXPORT_PLAYLIST_PATH "playlist.m3u"
+
+#define WORKERS_CAP 8
+
+#define DECODER_CHUNK_FRAMES 4096
+#define DECODER_MAX_CHANNELS 8
+
+#define FP_RATE 11025
+#define FP_FRAME 2048 // Must be a power of two
+#define FP_HOP 1024
+#define FP_MAX_SECONDS 120
+#define FP_MAX_OFFSET 8 // Frames of misalignment tolerated between two copies of a song
+#define FP_MAX_BIT_ERROR .2f
+#define FP_MIN_CHROMA_SIMILARITY .97f
+#define FP_BUCKETS_CAP 4096 // 12 bit chroma keys
+
+#define PREFLIGHT_AHEAD 4 // Upcoming songs validated ahead of time
+#define PREFLIGHT_PROBE_BYTES (256*1024)
+#define PREFLIGHT_DECODE_FRAMES 4096
+
+// Time stretch, in stream frames. The reader is kept between STRETCH_MIN_DELAY and STRETCH_MAX_DELAY
+// behind the writer and jumps by about STRETCH_JUMP, crossfading, when it drifts out of that range
+#define STRETCH_RING_CAP 8192 // Must be a power of two
+#define STRETCH_XFADE 512     // Must be a multiple of 4
+#define STRETCH_SEARCH 256
+#define STRETCH_JUMP 1536
+#define STRETCH_MIN_DELAY (2*STRETCH_XFADE + STRETCH_SEARCH + 64)
+#define STRETCH_MAX_DELAY (STRETCH_MIN_DELAY + STRETCH_JUMP + 2*STRETCH_SEARCH)
+#define STRETCH_START_DELAY ((STRETCH_MIN_DELAY + STRETCH_MAX_DELAY) / 2)
+#define STRETCH_MAX_CHANNELS 8
+
+#define CACHE_DIR_NAME "player"
+#define MODULE_RENDER_RATE 44100
+#define MODULE_CACHE_ENV "PLAYER_MODULE_CACHE_MB"
+#define MODULE_CACHE_DEFAULT_MB 1024
+
+#define TRANSCODE_ENV "PLAYER_QOA_CACHE_MB"
+#define TRANSCODE_SCAN_PER_FRAME 64
+#define TRANSCODE_RECENT 16 // Recently played tracks transcoded ahead of the rest of the playlist
+
+#define LIBRARY_READ_CAP (64*1024)
+#define LIBRARY_WATCH_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE \
+                            | IN_MOVE_SELF | IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+#define ASSETS_BLOB_NAME "assets.bin"
+#define ASSETS_BLOB_MAGIC "PLAYASST"
+#define ASSETS_BLOB_VERSION 1
+#define ASSETS_GLYPH_COUNT 95 // ASCII 32..126, same as LoadFontEx() with no codepoints
+#define ASSETS_GLYPH_PADDING 4
+
+#define CTL_QUEUE_CAP 4096 // Must be a power of two
+#define CTL_POLL_MS 100
+
+#define INPUT_LOG_MAGIC "# player input log v1"
+
 #define DA_PUSH(vec, x) do {                                                         \
     assert((vec).count >= 0  && "Count can't be negative");                          \
     if ((vec).count >= (vec).cap) {                                                  \
@@ -37,6 +132,15 @@
     (vec).songs[(vec).count++] = (x);                                                \
 } while (0)
 
+// Grows the array once to fit `n` more elements instead of doubling repeatedly
+#define DA_RESERVE(vec, n) do {                                                      \
+    if ((vec).count + (n) > (vec).cap) {                                             \
+        (vec).cap = MAX((vec).count + (n), (vec).cap*2);                             \
+        (vec).songs = realloc((vec).songs, (vec).cap*sizeof(*(vec).songs));          \
+        assert((vec).songs != NULL && "Buy more RAM lol");                           \
+    }                                                                                \
+} while (0)
+
 #define DA_LEN(vec) (sizeof(vec)/sizeof(vec[0]))
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -48,11 +152,8 @@
     Texture_Label name##_t;                                                          \
     bool name##_texture_loaded                                                       \
 
-#define INIT_TEXTURE(texture_, path)                                                 \
-    if (!plug->texture_##_texture_loaded) {                                          \
-        plug->texture_##_t.texture = LoadTexture(path);                              \
-        plug->texture_##_texture_loaded = true;                                      \
-    }                                                                                \
+// Textures themselves arrive with the assets, see plug_assets_job_done()
+#define INIT_TEXTURE(texture_)                                                       \
     plug->texture_##_t.position = position;                                          \
     plug->texture_##_t.rotation = rotation;                                          \
     plug->texture_##_t.scale = scale;                                                \
@@ -65,14 +166,14 @@
     }
 
 #define INIT_CONSTANT_TEXT_LABEL(label_)                                             \
-    plug->label_.text_size = MeasureTextEx(plug->font, plug->label_.text,            \
+    plug->label_.text_size = MeasureTextEx(plug_font(), plug->label_.text,           \
                                            plug->font_size, plug->font_spacing);     \
     plug->label_.text_pos = center_text(plug->label_.text_size);
 
 #define INIT_TEXT_LABEL(label_, msg, margin)                                         \
     if (cpydef) {                                                                    \
         strcpy(plug->label_.text, msg);                                              \
-        plug->label_.text_size = MeasureTextEx(plug->font, plug->label_.text,        \
+        plug->label_.text_size = MeasureTextEx(plug_font(), plug->label_.text,       \
                                                plug->font_size, plug->font_spacing); \
     }                                                                                \
     plug->label_.text_pos = center_text(plug->label_.text_size);                     \
@@ -80,7 +181,7 @@
     plug->label_.text_pos.y = GetScreenHeight() - margin;                            \
 
 #define DRAW_TEXT_EX(name, color) do {                                               \
-    DrawTextEx(plug->font,                                                           \
+    DrawTextEx(plug_font(),                                                          \
            plug->name.text,                                                          \
            plug->name.text_pos,                                                      \
            plug->font_size,                                                          \
@@ -110,7 +211,7 @@
 
 #define UPDATE_POPUP_MSG(type)                                                       \
     plug->show_popup_msg = true;                                                     \
-    plug->popup_msg_start_time = GetTime();                                          \
+    plug->popup_msg_start_time = plug->input.time;                                   \
     plug->popup_msg_type = type                                                      \
 
 typedef struct {
@@ -154,10 +255,32 @@ typedef struct {
     Vector2 end_pos;
 } Seek_Track;
 
+enum Fp_State {
+    FP_NONE,
+    FP_PENDING,
+    FP_DONE,
+};
+
+enum Check_State {
+    CHECK_NONE,
+    CHECK_PENDING,
+    CHECK_OK,
+    CHECK_BAD, // Missing, corrupt or undecodable, never picked to play
+};
+
 typedef struct {
     char path[TEXT_CAP];
 
+    size_t id;
     size_t times_played;
+
+    enum Fp_State fp_state;
+    size_t duplicate_of; // Id of the song this one duplicates, 0 if none
+    size_t generation;   // Bumped when the file changes, results of jobs started before are dropped
+
+    enum Check_State check_state;
+
+    bool gone; // Deleted or moved away on disk, see plug_library_poll()
     // ...
 } Song;
 
@@ -171,12 +294,175 @@ typedef struct {
 
     Song prev_song;
 
+    size_t last_id;
+
+    // Shuffle picks drawn ahead of time, so they can be validated before they're needed
+    size_t upcoming[PREFLIGHT_AHEAD];
+    size_t upcoming_count;
+
     float length;
 
     float time_check;
     float time_played;
 } Playlist;
 
+// Work for the background pool. `run` is called on a worker thread and must not touch
+// `plug`, `done` is called afterwards on the main thread and owns (frees) the job.
+// Jobs still pending on shutdown or hot reload get `done` with `cancelled` set.
+typedef struct Job {
+    void (*run)(struct Job*);
+    void (*done)(struct Job*);
+
+    struct Job* next;
+
+    bool cancelled;
+} Job;
+
+typedef struct {
+    pthread_t threads[WORKERS_CAP];
+    size_t count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    Job* pending;
+    Job* pending_tail;
+    Job* finished;
+
+    size_t in_flight;
+
+    bool stopping;
+} Worker_Pool;
+
+typedef struct {
+    Job job;
+
+    size_t song_id;
+    size_t song_hint;
+
+    char path[TEXT_CAP];
+
+    bool ok;
+    const char* reason; // Static string, set when !ok
+} Preflight_Job;
+
+// Backing memory of the current music stream, the decoders read straight out of it. A copy of
+// the file, so it can be rewritten or truncated on disk while it plays.
+typedef struct {
+    unsigned char* data;
+    size_t size;
+} Music_Data;
+
+#ifdef STREAM_DECODE
+enum Decoder_Format {
+    DECODER_WAV,
+    DECODER_MP3,
+    DECODER_OGG,
+    DECODER_QOA,
+};
+
+// Pulls 16 bit interleaved frames out of a file a chunk at a time. Through stdio, so only the
+// chunk being decoded is in memory and a file truncated underneath just ends early.
+typedef struct {
+    enum Decoder_Format format;
+
+    unsigned int channels;
+    unsigned int sample_rate;
+
+    union {
+        drwav wav;
+        drmp3 mp3;
+        stb_vorbis* ogg;
+        struct {
+            qoa_desc desc;
+            FILE* file;
+            unsigned char* bytes; // One encoded frame, qoa_max_frame_size() long
+            short* frame;      // QOA_FRAME_LEN*channels samples
+            unsigned int len;  // Frames decoded into `frame`
+            unsigned int pos;  // Frames of `frame` already read
+        } qoa;
+    };
+} Decoder;
+#endif
+
+enum Asset {
+    ASSET_FONT,
+    ASSET_MUTED,
+    ASSET_UNMUTED,
+    ASSET_SHUFFLE,
+    ASSET_CROSSED_SHUFFLE,
+    ASSETS_CAP,
+};
+
+// Layout of the baked assets blob, images are GPU-ready pixels, 16 byte aligned
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t font_size;
+
+    int64_t mtimes[ASSETS_CAP]; // Of the sources, a newer source invalidates the blob
+
+    int32_t glyph_count;
+    int32_t glyph_padding;
+    uint32_t glyphs_offset;
+
+    struct {
+        int32_t width;
+        int32_t height;
+        int32_t format;
+        uint32_t offset;
+        uint32_t size;
+    } images[ASSETS_CAP];
+} Assets_Blob_Header;
+
+typedef struct {
+    int32_t value;
+    int32_t offset_x;
+    int32_t offset_y;
+    int32_t advance_x;
+    Rectangle rec;
+} Assets_Blob_Glyph;
+
+typedef struct {
+    Job job;
+
+    int font_size;
+    char blob_path[TEXT_CAP];
+
+    Image images[ASSETS_CAP]; // Font atlas, then the icons
+    GlyphInfo* glyphs;
+    Rectangle* recs;
+    int glyph_count;
+    int glyph_padding;
+
+    void* blob; // Mapping the images point into, NULL when they were decoded
+    size_t blob_size;
+
+    bool ok;
+    double elapsed;
+} Assets_Job;
+
+// Pitch shifter undoing what SetMusicPitch() does to the pitch, so speed changes keep it.
+// Runs on the audio thread as a stream processor, on the stream's interleaved floats.
+// A stream starting at x1 passes through dry, with the ring kept filled to splice into once
+// the speed changes. From then on x1 reads the ring at whatever delay it's at, which is a copy.
+typedef struct {
+    float ring[STRETCH_RING_CAP*STRETCH_MAX_CHANNELS];
+    int64_t written;
+    size_t channels;
+
+    bool active;  // Otherwise frames pass through dry
+    double read;  // Absolute frame position of the reader
+    double xfade; // Position the reader is crossfading to
+    size_t xfade_left;
+    bool xfade_dry; // Crossfading from the dry frames rather than the reader, when turning active
+
+    float ref[STRETCH_XFADE];
+    float candidates[2*STRETCH_SEARCH + STRETCH_XFADE];
+
+    _Atomic float ratio; // Pitch ratio to apply, 1/speed
+} Time_Stretch;
+
 enum App_State {
     WAITING_FOR_FILE,
     MAIN_SCREEN
@@ -197,8 +483,278 @@ enum Popup_Msg {
 
     MUTE_MUSIC,
     UNMUTE_MUSIC,
+
+    EXPORT_PLAYLIST,
+
+    SPEED_UP,
+    SPEED_DOWN,
+};
+
+enum Playlist_Format {
+    PLAYLIST_M3U,
+    PLAYLIST_PLS,
+};
+
+typedef struct {
+    const char* begin;
+    const char* end;
+
+    enum Playlist_Format format;
+
+    const char* base_dir;
+    size_t base_dir_len;
+
+    size_t count;
+
+    Song* out; // NULL on the counting pass
+} Playlist_Chunk;
+
+typedef struct {
+    size_t song_id;
+    size_t song_hint; // Index of the song when last seen, songs only move on a library compaction
+
+    float duration;
+    float chroma[12]; // Mean chroma, normalized
+
+    uint32_t* frames; // One sub-fingerprint per analysis frame
+    size_t count;
+} Fingerprint;
+
+typedef struct {
+    Job job;
+
+    size_t song_id;
+    size_t song_hint; // Index the song had when the job was submitted
+    size_t generation;
+
+    char path[TEXT_CAP];
+
+    Fingerprint fp;
+
+    double cpu_time;
+} Fingerprint_Job;
+
+typedef struct {
+    size_t* items;
+    size_t count;
+    size_t cap;
+} Fp_Bucket;
+
+typedef struct {
+    Fingerprint* items;
+    size_t count;
+    size_t cap;
+
+    Fp_Bucket buckets[FP_BUCKETS_CAP];
+
+    size_t cursor; // Next playlist index to look at
+
+    size_t tracks;
+    size_t duplicates;
+    double cpu_time;
+
+    bool pass_logged;
+} Fp_Index;
+
+typedef struct {
+    char name[64];
+    time_t mtime;
+    uint64_t size;
+} Cache_Entry;
+
+// What's left of one kind of cached file after eviction
+typedef struct {
+    uint64_t size;
+    size_t count;
+    time_t oldest; // Of the least recently used one kept
+} Cache_Usage;
+
+typedef struct {
+    Job job;
+
+    size_t song_id;
+    uint64_t hash;
+
+    char path[TEXT_CAP];
+    char out_path[TEXT_CAP];
+    char cache_dir[TEXT_CAP];
+    uint64_t budget;
+
+    bool ok;
+    double elapsed;
+    float duration;
+} Module_Render_Job;
+
+typedef struct {
+    Job job;
+
+    size_t song_id;
+
+    char path[TEXT_CAP];
+    char out_path[TEXT_CAP];
+    char cache_dir[TEXT_CAP];
+    uint64_t budget;
+    time_t recency; // Given to the copy as its mtime, what eviction orders by
+
+    bool ok;
+    double elapsed;
+    float duration;
+
+    Cache_Usage cache; // After eviction
+} Transcode_Job;
+
+typedef struct {
+    size_t song_id;
+    size_t song_hint;
+    time_t played;
+} Transcode_Recent;
+
+enum Ctl_Cmd_Type {
+    CTL_NOP,
+    CTL_ADD,
+    CTL_PLAY,
+    CTL_PAUSE,
+    CTL_NEXT,
+    CTL_PREV,
+    CTL_SEEK,
+    CTL_VOLUME,
+    CTL_IMPORT,
+    CTL_EXPORT,
+    CTL_SPEED,
+};
+
+typedef struct {
+    enum Ctl_Cmd_Type type;
+
+    float arg;
+
+    char* path; // Owned by the command, only set for CTL_ADD, CTL_IMPORT and CTL_EXPORT
+} Ctl_Cmd;
+
+// Single producer (control thread), single consumer (main loop) ring buffer
+typedef struct {
+    Ctl_Cmd cmds[CTL_QUEUE_CAP];
+
+    _Atomic size_t head;
+    _Atomic size_t tail;
+} Ctl_Queue;
+
+// What the control thread is allowed to see of the player, published once per frame
+typedef struct {
+    bool music_loaded;
+    bool music_paused;
+
+    size_t curr;
+    size_t count;
+
+    float length;
+    float time_played;
+    float music_volume;
+
+    char path[TEXT_CAP];
+} Ctl_State;
+
+typedef struct {
+    Ctl_Queue queue;
+
+    pthread_t thread;
+    pthread_mutex_t state_lock;
+
+    Ctl_State state;
+
+    int listen_fd;
+    struct sockaddr_un addr;
+
+    _Atomic bool running;
+
+    bool started;
+} Ctl_Server;
+
+enum Input_Event_Type {
+    INPUT_KEY,
+    INPUT_CLICK,
+    INPUT_RESIZE,
+    INPUT_DROP,
+    INPUT_END,
 };
 
+typedef struct {
+    size_t frame;
+    double time;
+
+    enum Input_Event_Type type;
+
+    int key;
+    Vector2 mouse;
+    int width, height;
+    char* path;
+} Input_Event;
+
+// What the handlers get to see of the input in a frame, polled from raylib or replayed from a log
+typedef struct {
+    size_t frame;
+    double time;
+    double dt;
+
+    int key;
+    bool clicked;
+    Vector2 mouse;
+    bool resized;
+    FilePathList dropped;
+
+    FILE* record;
+    double record_start;
+
+    bool replaying;
+    Input_Event* events;
+    size_t events_count;
+    size_t events_cap;
+    size_t next_event;
+    char** drop_paths;
+    size_t drop_paths_cap;
+} Input;
+
+typedef struct {
+    char* name;
+    unsigned char type; // d_type
+} Library_Entry;
+
+// Directories dropped on the player, watched with inotify. There's no thread to it: the events are
+// read from plug_frame() without blocking and applied to the playlist a frame's worth at a time.
+typedef struct {
+    int fd;
+    bool watching;
+
+    char** roots;
+    size_t roots_count;
+    size_t roots_cap;
+
+    char** dirs; // Directory of each watch, indexed by watch descriptor
+    size_t dirs_cap;
+
+    // Song index + 1 by path, open addressing. Covers the first `table_songs` songs, the ones
+    // appended since are put in before every batch, it's rebuilt after a compaction.
+    size_t* table;
+    size_t table_cap;
+    size_t table_used;
+    size_t table_songs;
+
+    size_t gone;         // Songs marked gone, still in the playlist
+    size_t lingering_id; // Gone while playing, removed once playback moves on
+
+    // IN_MOVED_FROM waiting for its IN_MOVED_TO
+    bool move_pending;
+    bool move_is_dir;
+    uint32_t move_cookie;
+    char move_from[TEXT_CAP];
+
+    size_t events;
+    size_t batches;
+    size_t overflows;
+    double cpu_time;
+    double worst_batch;
+} Library;
+
 typedef struct {
     enum App_State app_state;
 
@@ -223,6 +779,10 @@ typedef struct {
     enum Popup_Msg popup_msg_type;
 
     bool font_loaded;
+    bool assets_loading;
+
+    double frame_timer_start;
+    const char* frame_timer_label; // Logs the time until the next frame is drawn, NULL if not running
 
     bool music_muted;
     bool music_loaded;
@@ -236,27 +796,103 @@ typedef struct {
     TEXTURE(crossed_shuffle);
 
     Music curr_music;
+    Music_Data curr_music_data;
+
+    float music_speed;
+    Time_Stretch stretch;
+    bool stretch_attached; // Not on streams with more than STRETCH_MAX_CHANNELS
+
+    // Playback clock for when there's no audio device, see plug_music_playing()
+    bool null_sink;
+    float null_sink_time;
+
+    Input input;
+
+    char cache_dir[TEXT_CAP];
+
+    uint64_t module_rendering; // Hash of the module being rendered, 0 if none
+    uint64_t module_budget;    // Bytes the rendered modules may take up, 0 if rendering is off
+
+    uint64_t transcode_budget; // Bytes the QOA copies may take up, 0 if transcoding is off
+    size_t transcode_cursor;
+    bool transcoding;
+    bool transcode_scanned; // The cache's totals are known
+    bool transcode_recheck; // The playing, upcoming or recently played tracks changed
+    time_t transcode_floor; // Copies used before this would be the first to go, -1 while there's room
+    Transcode_Recent transcode_recent[TRANSCODE_RECENT]; // Most recent first
+    size_t transcode_recent_count;
 
     float music_volume;
 
     Playlist pl;
+
+    Ctl_Server ctl;
+
+    Worker_Pool workers;
+    Worker_Pool idle_workers;
+
+    Fp_Index fp;
+
+    Library library;
 } Plug;
 
 bool is_music(const char*);
+bool is_playlist(const char*);
 bool is_mouse_on_track(Vector2, Seek_Track);
+bool is_song_skipped(const Song*);
 Vector2 center_text(Vector2);
 Song new_song(const char*, size_t);
 void get_song_name(const char*, char*, size_t);
 
 bool plug_load_music(Song*);
+bool plug_swap_music(const char*, float);
+bool plug_music_playing(void);
+float plug_music_time(void);
+void plug_music_seek(float);
+void plug_input_poll(void);
+bool plug_input_record(const char*, unsigned int);
+bool plug_input_replay(const char*);
+bool plug_input_replay_done(void);
+void plug_input_close(void);
+void plug_workers_drain(void);
+void plug_attach_music(Music);
+void plug_detach_music(Music);
+void plug_set_music_speed(float);
+void time_stretch_reset(Time_Stretch*, size_t);
+void time_stretch_process(Time_Stretch*, float*, size_t);
+void time_stretch_processor(void*, unsigned int);
+bool music_data_open(const char*, Music_Data*);
+void music_data_close(Music_Data*);
+Music load_music_from_data(const char*, const Music_Data*);
+size_t id3v2_size(const unsigned char*, size_t);
+#ifdef STREAM_DECODE
+Decoder* decoder_open(const char*);
+uint64_t decoder_frame_count(Decoder*);
+size_t decoder_read(Decoder*, short*, size_t);
+void decoder_close(Decoder*);
+#endif
+
+bool is_module(const char*);
+uint64_t hash_bytes(const unsigned char*, size_t);
+void plug_init_cache_dir(void);
+bool plug_cache_path(const char*, char*);
+Cache_Usage plug_cache_evict(const char*, const char*, const char*, const char*, uint64_t);
+bool plug_module_cache_lookup(const Song*, char*, uint64_t*);
+void plug_module_render_submit(const Song*, uint64_t, const char*);
+bool plug_push_song(const char*);
+bool plug_import_playlist(const char*);
+bool plug_export_playlist(const char*);
 bool plug_play_next_song(void);
 
 Song* plug_get_curr_song(void);
 Song* plug_get_nth_song(size_t);
+Song* plug_find_song(size_t, size_t);
 
 size_t plug_pull_next_song(void);
 size_t plug_pull_prev_song(void);
 
+void plug_next_song(void);
+void plug_prev_song(void);
 void plug_print_songs(void);
 void plug_load_all(void);
 void plug_unload_all(void);
@@ -270,11 +906,54 @@ void plug_init_track(bool);
 void plug_init_textures(void);
 void plug_init_text_labels(bool);
 void plug_init_constant_text_labels(void);
+Font plug_font(void);
+void plug_load_assets(void);
+
+void plug_ctl_start(void);
+void plug_ctl_stop(void);
+void plug_ctl_publish_state(void);
+void plug_handle_ctl_commands(void);
+void* ctl_thread(void*);
+void* playlist_chunk_thread(void*);
+
+void plug_workers_start(void);
+void plug_workers_stop(void);
+void plug_workers_submit(Job*);
+void plug_workers_submit_front(Job*);
+void plug_workers_poll(void);
+void plug_idle_workers_submit(Job*);
+void* idle_worker_thread(void*);
+void* worker_thread(void*);
+
+bool fingerprint_compute(const char*, Fingerprint*);
+float fingerprint_similarity(const Fingerprint*, const Fingerprint*);
+void fp_index_free(Fp_Index*);
+void fp_index_insert(Fp_Index*, Fingerprint);
+void fp_index_remove(Fp_Index*, const size_t*, size_t);
+Fingerprint* fp_index_lookup(Fp_Index*, const Fingerprint*);
+void plug_fingerprint_schedule(void);
+void plug_init_transcode_budget(void);
+bool is_transcodable(const char*);
+bool plug_transcode_cache_path(const char*, char*);
+bool plug_transcode_lookup(const char*, char*);
+void plug_transcode_played(const Song*);
+void plug_transcode_schedule(void);
+
+bool plug_library_add(const char*);
+void plug_library_poll(void);
+void plug_library_close(void);
+
+const char* preflight_check(const char*);
+void plug_preflight_schedule(void);
+void plug_mark_song_bad(Song*);
 
 const char* SUPPORTED_FORMATS[SUPPORTED_FORMATS_CAP] = {".xm", ".wav", ".ogg", ".mp3", ".qoa", ".mod"};
 
 static Plug* plug = NULL;
 
+// Set by the replay driver before plug_init(): input comes from this log and there's no control socket
+static const char* replay_path = NULL;
+
 void plug_init(void)
 {
     plug = malloc(sizeof(*plug));
@@ -286,6 +965,19 @@ void plug_init(void)
     plug->font_size = 50.f;
     plug->font_spacing = 2.f;
 
+    plug->frame_timer_start = GetTime();
+    plug->frame_timer_label = "Time to first frame";
+
+    plug_init_cache_dir();
+
+    plug_init_transcode_budget();
+
+    pthread_mutex_init(&plug->workers.lock, NULL);
+    pthread_cond_init(&plug->workers.cond, NULL);
+    pthread_mutex_init(&plug->idle_workers.lock, NULL);
+    pthread_cond_init(&plug->idle_workers.cond, NULL);
+    plug_workers_start();
+
     plug_load_all();
 
     plug_init_textures();
@@ -294,10 +986,21 @@ void plug_init(void)
     plug_init_constant_text_labels();
     plug->app_state = WAITING_FOR_FILE;
     plug->music_volume = DEFAULT_MUSIC_VOLUME;
+    plug->music_speed = 1.f;
+    plug->null_sink = !IsAudioDeviceReady();
+
+    pthread_mutex_init(&plug->ctl.state_lock, NULL);
+    if (replay_path) plug_input_replay(replay_path);
+    else plug_ctl_start();
 }
 
 void* plug_pre_reload(void)
 {
+    plug->frame_timer_start = GetTime();
+
+    // The background threads run code from this library, so they can't outlive it
+    plug_ctl_stop();
+    plug_workers_stop();
     plug_unload_all();
     return plug;
 }
@@ -305,37 +1008,42 @@ void* plug_pre_reload(void)
 void plug_post_reload(void* pplug)
 {
     plug = pplug;
+    // Set from here, a label from the old library would dangle after it's closed
+    plug->frame_timer_label = "Reload time";
+    plug_workers_start();
     plug_load_all();
+    plug_ctl_start();
 }
 
 void plug_load_all(void)
 {
     TraceLog(LOG_INFO, "LOADING ALL");
-    plug->font = LoadFontEx(FONT_PATH, plug->font_size, 0, 0);
-    plug->font_loaded = true;
-    GenTextureMipmaps(&plug->font.texture);
-    SetTextureFilter(plug->font.texture, TEXTURE_FILTER_BILINEAR);
+    plug_load_assets();
     plug_init_textures();
     Song* curr_song = plug_get_curr_song();
     TraceLog(LOG_INFO, "LOADING MUSIC STREAM");
     if (curr_song && plug_load_music(curr_song)) {
         SetMusicVolume(plug->curr_music, plug->music_volume);
-        SeekMusicStream(plug->curr_music, plug->pl.time_played);
+        plug_music_seek(plug->pl.time_played);
     }
 }
 
 void plug_unload_music(void)
 {
     TraceLog(LOG_INFO, "UNLOADING MUSIC STREAM");
+    plug_detach_music(plug->curr_music);
     StopMusicStream(plug->curr_music);
     plug->music_loaded = false;
     UnloadMusicStream(plug->curr_music);
+    music_data_close(&plug->curr_music_data);
 }
 
 void plug_unload_all(void)
 {
     TraceLog(LOG_INFO, "UNLOADING ALL");
-    if (IsMusicStreamPlaying(plug->curr_music) && plug->music_loaded) plug_unload_music();
+    if (plug_music_playing() && plug->music_loaded) plug_unload_music();
+    // A paused stream stays loaded, but the processor lives in this library
+    if (plug->music_loaded) plug_detach_music(plug->curr_music);
     UNLOAD_TEXTURE(muted);
     UNLOAD_TEXTURE(unmuted);
     UNLOAD_TEXTURE(shuffle);
@@ -349,6 +1057,22 @@ void plug_unload_all(void)
 
 void plug_free(void)
 {
+    const bool ctl_owned = plug->ctl.started;
+    plug_ctl_stop();
+    if (ctl_owned) unlink(plug->ctl.addr.sun_path);
+    for (Ctl_Queue* q = &plug->ctl.queue; q->head != q->tail; ++q->head)
+        free(q->cmds[q->head & (CTL_QUEUE_CAP - 1)].path);
+    pthread_mutex_destroy(&plug->ctl.state_lock);
+
+    plug_workers_stop();
+    pthread_mutex_destroy(&plug->workers.lock);
+    pthread_cond_destroy(&plug->workers.cond);
+    pthread_mutex_destroy(&plug->idle_workers.lock);
+    pthread_cond_destroy(&plug->idle_workers.cond);
+    fp_index_free(&plug->fp);
+    plug_input_close();
+    plug_library_close();
+
     plug_unload_all();
     free(plug->pl.songs);
     TraceLog(LOG_INFO, "FREED ALLOCATED SONGS");
@@ -364,9 +1088,17 @@ void plug_reinit(void)
 
 void plug_frame(void)
 {
-    if (IsWindowResized()) plug_reinit();
+    plug_input_poll();
+    if (plug->input.resized) plug_reinit();
 
     plug_handle_dropped_files();
+    plug_handle_ctl_commands();
+
+    plug_workers_poll();
+    plug_preflight_schedule();
+    plug_fingerprint_schedule();
+    plug_transcode_schedule();
+    plug_library_poll();
 
     if (plug->app_state == MAIN_SCREEN) {
         plug_handle_keys();
@@ -375,15 +1107,20 @@ void plug_frame(void)
 
     if (plug->music_loaded && !plug->music_paused && plug->app_state == MAIN_SCREEN) {
         UpdateMusicStream(plug->curr_music);
-        plug->pl.time_played = GetMusicTimePlayed(plug->curr_music);
+        if (plug->null_sink) plug->null_sink_time += plug->input.dt*plug->music_speed;
+        plug->pl.time_played = plug_music_time();
 
         if (plug->pl.time_played >= plug->pl.length - 0.035) {
             TraceLog(LOG_INFO, "Song ended, playing next one");
             plug_play_next_song();
         }
 
-        snprintf(plug->song_time.text, TEXT_CAP, "Time played: %.1f / %.1f seconds",
-                 plug->pl.time_played, plug->pl.length);
+        // Source time, whatever the playback speed
+        if (plug->music_speed != 1.f)
+            snprintf(plug->song_time.text, TEXT_CAP, "Time played: %.1f / %.1f seconds (x%.2f)",
+                     plug->pl.time_played, plug->pl.length, plug->music_speed);
+        else snprintf(plug->song_time.text, TEXT_CAP, "Time played: %.1f / %.1f seconds",
+                      plug->pl.time_played, plug->pl.length);
 
         // Update seek track cursor
         {
@@ -401,11 +1138,18 @@ void plug_frame(void)
         if (plug->pl.time_check > 1.f) plug->pl.time_check = 1.f;
     }
 
+    plug_ctl_publish_state();
+
     BeginDrawing();
         ClearBackground(plug->background_color);
         if (plug->app_state == WAITING_FOR_FILE) DRAW_TEXT_EX(waiting_for_file_msg, RAYWHITE);
         else if (plug->app_state == MAIN_SCREEN) plug_draw_main_screen();
     EndDrawing();
+
+    if (plug->frame_timer_label) {
+        TraceLog(LOG_INFO, "%s: %.3f seconds", plug->frame_timer_label, GetTime() - plug->frame_timer_start);
+        plug->frame_timer_label = NULL;
+    }
 }
 
 void plug_draw_main_screen(void)
@@ -414,7 +1158,7 @@ void plug_draw_main_screen(void)
     DRAW_TEXT_EX(song_time, RAYWHITE);
 
     if (plug->show_popup_msg) {
-        if (GetTime() - plug->popup_msg_start_time < POPUP_MSG_DURATION) {
+        if (plug->input.time - plug->popup_msg_start_time < POPUP_MSG_DURATION) {
             switch (plug->popup_msg_type) {
             case SEEK_FORWARD: snprintf(plug->popup_msg.text, TEXT_CAP, "+ %.1f  ", DEFAULT_MUSIC_SEEK_STEP); break;
             case SEEK_BACKWARD: snprintf(plug->popup_msg.text, TEXT_CAP, "- %.1f  ", DEFAULT_MUSIC_SEEK_STEP); break;
@@ -432,6 +1176,11 @@ void plug_draw_main_screen(void)
             case MUTE_MUSIC: DRAW_TEXTURE_EX(muted); break;
             case UNMUTE_MUSIC: DRAW_TEXTURE_EX(unmuted); break;
 
+            case EXPORT_PLAYLIST: strcpy(plug->popup_msg.text, "Saved"); break;
+
+            case SPEED_UP:
+            case SPEED_DOWN: snprintf(plug->popup_msg.text, TEXT_CAP, "x%.2f", plug->music_speed); break;
+
             default: assert(NULL && "Unexpected case");
             }
             if (plug->popup_msg_type != ENABLE_SHUFFLE_MODE
@@ -448,38 +1197,29 @@ void plug_draw_main_screen(void)
 
 void plug_handle_dropped_files(void)
 {
-    if (IsFileDropped()) {
-        FilePathList files = LoadDroppedFiles();
+    if (plug->input.dropped.count > 0) {
+        const FilePathList files = plug->input.dropped;
         for (size_t i = 0; i < files.count; ++i) {
-            if (!is_music(files.paths[i]))
-                TraceLog(LOG_ERROR, "Couldn't load music from file: %s", files.paths[i]);
-            else {
-                const Song song = new_song(files.paths[i], 0);
-                DA_PUSH(plug->pl, song);
-#ifdef DEBUG
-                TraceLog(LOG_INFO, "Pushed into the playlist this one: %s", files.paths[i]);
-                TraceLog(LOG_INFO, "Music count in the vm array: %zu\n", plug->pl.count);
-#endif
-                plug_print_songs();
-            }
+            if (is_playlist(files.paths[i])) plug_import_playlist(files.paths[i]);
+            else if (DirectoryExists(files.paths[i])) {
+                if (plug_library_add(files.paths[i])) plug_print_songs();
+            } else if (plug_push_song(files.paths[i])) plug_print_songs();
         }
 
-        if (!plug->music_loaded) plug_load_music(&plug->pl.songs[0]);
+        if (!plug->music_loaded && plug->pl.count > 0) plug_load_music(&plug->pl.songs[0]);
 
 #ifdef DEBUG
         TraceLog(LOG_INFO, "Curr: %zu, prev: %zu, count: %zu\n", plug->pl.curr, plug->pl.prev, plug->pl.count);
 #endif
-
-        UnloadDroppedFiles(files);
     }
 }
 
 void plug_handle_buttons(void)
 {    
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-        Vector2 mouse_pos = GetMousePosition();
+    if (plug->input.clicked) {
+        Vector2 mouse_pos = plug->input.mouse;
 
-        if (is_mouse_on_track(mouse_pos, plug->seek_track) && IsMusicStreamPlaying(plug->curr_music)) {
+        if (is_mouse_on_track(mouse_pos, plug->seek_track) && plug_music_playing()) {
             plug->seek_track.cursor.rect.x = mouse_pos.x;
 
             const float position = (mouse_pos.x
@@ -487,49 +1227,49 @@ void plug_handle_buttons(void)
                 / (plug->seek_track.end_pos.x - plug->seek_track.start_pos.x)
                 * plug->pl.length;
 
-            SeekMusicStream(plug->curr_music, position);
+            plug_music_seek(position);
         }
     }
 }
 
 void plug_handle_keys(void)
 {
-    switch (GetKeyPressed()) {
-    case KEY_SPACE: if (IsMusicStreamPlaying(plug->curr_music)) {
+    switch (plug->input.key) {
+    case KEY_SPACE: if (plug_music_playing()) {
         plug->music_paused = !plug->music_paused;
         if (plug->music_paused) PauseMusicStream(plug->curr_music);
         else                    ResumeMusicStream(plug->curr_music);
         break;
     }
 
-    case KEY_LEFT: if (IsMusicStreamPlaying(plug->curr_music)) {
+    case KEY_LEFT: if (plug_music_playing()) {
         UPDATE_POPUP_MSG(SEEK_BACKWARD);
         {
-            float curr_pos = GetMusicTimePlayed(plug->curr_music);
+            float curr_pos = plug_music_time();
             float future_pos = MAX(curr_pos - DEFAULT_MUSIC_SEEK_STEP, 0.0);
-            SeekMusicStream(plug->curr_music, future_pos);
+            plug_music_seek(future_pos);
         }
         break;
     }
 
-    case KEY_RIGHT: if (IsMusicStreamPlaying(plug->curr_music)) {
+    case KEY_RIGHT: if (plug_music_playing()) {
         UPDATE_POPUP_MSG(SEEK_FORWARD);
         {
-            float curr_pos = GetMusicTimePlayed(plug->curr_music);
+            float curr_pos = plug_music_time();
             float future_pos = MIN(curr_pos + DEFAULT_MUSIC_SEEK_STEP, GetMusicTimeLength(plug->curr_music));
-            SeekMusicStream(plug->curr_music, future_pos);
+            plug_music_seek(future_pos);
         }
         break;
     }
 
-    case KEY_UP: if (IsMusicStreamPlaying(plug->curr_music)) {
+    case KEY_UP: if (plug_music_playing()) {
         UPDATE_POPUP_MSG(VOLUME_UP);
         plug->music_volume = MIN(plug->music_volume + DEFAULT_MUSIC_VOLUME_STEP, 1.f);
         SetMusicVolume(plug->curr_music, plug->music_volume);
         break;
     }
 
-    case KEY_DOWN: if (IsMusicStreamPlaying(plug->curr_music)) {
+    case KEY_DOWN: if (plug_music_playing()) {
         UPDATE_POPUP_MSG(VOLUME_DOWN);
         plug->music_volume = MAX(plug->music_volume - DEFAULT_MUSIC_VOLUME_STEP, 0.f);
         SetMusicVolume(plug->curr_music, plug->music_volume);
@@ -538,37 +1278,15 @@ void plug_handle_keys(void)
 
     case KEY_N:
         UPDATE_POPUP_MSG(NEXT_SONG);
-        {
-            size_t next_index = plug_pull_next_song();
-            Song* song = plug_get_nth_song(next_index);
-#ifdef DEBUG
-            if (!song) TraceLog(LOG_ERROR, "Next song is NULL, curr: %zu", next_index);
-#endif
-            if (song && plug_load_music(song)) {
-                plug->pl.prev = plug->pl.curr;
-                TraceLog(LOG_INFO, "Set curr to: %zu", plug->pl.curr = next_index);
-                PlayMusicStream(plug->curr_music);
-            }
-        }
+        plug_next_song();
         break;
 
     case KEY_P:
         UPDATE_POPUP_MSG(PREV_SONG);
-        {
-            size_t next_index = plug_pull_prev_song();
-            Song* song = plug_get_nth_song(next_index);
-#ifdef DEBUG
-            if (!song) TraceLog(LOG_ERROR, "Prev song is NULL, curr: %zu", next_index);
-#endif
-            if (song && plug_load_music(song)) {
-                plug->pl.prev = next_index;
-                TraceLog(LOG_INFO, "Set curr to: %zu", plug->pl.curr = next_index);
-                PlayMusicStream(plug->curr_music);
-            }
-        }
+        plug_prev_song();
         break;                
 
-    case KEY_S: if (IsMusicStreamPlaying(plug->curr_music)) {
+    case KEY_S: if (plug_music_playing()) {
         plug->shuffle_mode = !plug->shuffle_mode;
         if (plug->shuffle_mode) {
             UPDATE_POPUP_MSG(DISABLE_SHUFFLE_MODE);
@@ -580,7 +1298,7 @@ void plug_handle_keys(void)
         break;
     }
    
-    case KEY_M: if (IsMusicStreamPlaying(plug->curr_music)) {
+    case KEY_M: if (plug_music_playing()) {
         plug->music_muted = !plug->music_muted;
         if (!plug->music_muted) {
             SetMusicVolume(plug->curr_music, plug->music_volume);
@@ -593,9 +1311,30 @@ void plug_handle_keys(void)
         }
         break;
     }
+
+    case KEY_E:
+        if (plug_export_playlist(EXPORT_PLAYLIST_PATH)) {
+            UPDATE_POPUP_MSG(EXPORT_PLAYLIST);
+        }
+        break;
+
+    case KEY_RIGHT_BRACKET: if (plug_music_playing()) {
+        UPDATE_POPUP_MSG(SPEED_UP);
+        plug_set_music_speed(plug->music_speed + DEFAULT_MUSIC_SPEED_STEP);
+    } break;
+
+    case KEY_LEFT_BRACKET: if (plug_music_playing()) {
+        UPDATE_POPUP_MSG(SPEED_DOWN);
+        plug_set_music_speed(plug->music_speed - DEFAULT_MUSIC_SPEED_STEP);
+    } break;
     }
 }
 
+Font plug_font(void)
+{
+    return plug->font_loaded ? plug->font : GetFontDefault();
+}
+
 void plug_init_constant_text_labels(void)
 {
     strcpy(plug->waiting_for_file_msg.text, WAITING_MESSAGE);
@@ -624,10 +1363,10 @@ void plug_init_textures(void)
     const float scale = 0.5;
     const Color color = WHITE;
 
-    INIT_TEXTURE(muted, MUTED_PATH);
-    INIT_TEXTURE(unmuted, UNMUTED_PATH);
-    INIT_TEXTURE(shuffle, SHUFFLE_PATH);
-    INIT_TEXTURE(crossed_shuffle, CROSSED_SHUFFLE_PATH);
+    INIT_TEXTURE(muted);
+    INIT_TEXTURE(unmuted);
+    INIT_TEXTURE(shuffle);
+    INIT_TEXTURE(crossed_shuffle);
 }
 
 void plug_init_track(bool cpydef)
@@ -676,48 +1415,112 @@ Song* plug_get_nth_song(size_t n)
     else return NULL;
 }
 
+// Duplicates are skipped so that shuffle doesn't over-weight songs dropped several times
 size_t plug_pull_next_song(void)
 {
     if (plug->shuffle_mode) {
+        while (plug->pl.upcoming_count > 0) {
+            const size_t ret = plug->pl.upcoming[0];
+            memmove(plug->pl.upcoming, plug->pl.upcoming + 1, --plug->pl.upcoming_count*sizeof(*plug->pl.upcoming));
+            if (ret < plug->pl.count && ret != plug->pl.prev && !is_song_skipped(&plug->pl.songs[ret])) return ret;
+        }
+
         size_t ret = PL_RAND(plug->pl.count);
-        while (ret == plug->pl.prev) ret = PL_RAND(plug->pl.count);
+        for (size_t tries = 0; tries < plug->pl.count && (ret == plug->pl.prev || is_song_skipped(&plug->pl.songs[ret])); ++tries)
+            ret = PL_RAND(plug->pl.count);
         return ret;
-    } else if (!plug->shuffle_mode && plug->pl.curr + 1 >= plug->pl.count)
-        return 0;
-    else return MIN(plug->pl.curr + 1, plug->pl.count - 1);
+    }
+
+    size_t ret = plug->pl.curr;
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        ret = ret + 1 >= plug->pl.count ? 0 : ret + 1;
+        if (!is_song_skipped(&plug->pl.songs[ret])) break;
+    }
+    return ret;
 }
 
 size_t plug_pull_prev_song(void)
 {
     if (plug->shuffle_mode) {
         size_t ret = PL_RAND(plug->pl.count);
-        while (ret == plug->pl.prev) ret = PL_RAND(plug->pl.count);
+        for (size_t tries = 0; tries < plug->pl.count && (ret == plug->pl.prev || is_song_skipped(&plug->pl.songs[ret])); ++tries)
+            ret = PL_RAND(plug->pl.count);
         return ret;
-    } else if (plug->pl.curr == 0)
-        return plug->pl.count - 1;
-    else return MAX(plug->pl.curr - 1, 0);
+    }
+
+    size_t ret = plug->pl.curr;
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        ret = ret == 0 ? plug->pl.count - 1 : ret - 1;
+        if (!is_song_skipped(&plug->pl.songs[ret])) break;
+    }
+    return ret;
+}
+
+Song* plug_find_song(size_t id, size_t hint)
+{
+    if (hint < plug->pl.count && plug->pl.songs[hint].id == id)
+        return &plug->pl.songs[hint];
+
+    for (size_t i = 0; i < plug->pl.count; ++i)
+        if (plug->pl.songs[i].id == id)
+            return &plug->pl.songs[i];
+
+    return NULL;
+}
+
+void plug_next_song(void)
+{
+    size_t next_index = plug_pull_next_song();
+    Song* song = plug_get_nth_song(next_index);
+#ifdef DEBUG
+    if (!song) TraceLog(LOG_ERROR, "Next song is NULL, curr: %zu", next_index);
+#endif
+    if (song && plug_load_music(song)) {
+        plug->pl.prev = plug->pl.curr;
+        TraceLog(LOG_INFO, "Set curr to: %zu", plug->pl.curr = next_index);
+        PlayMusicStream(plug->curr_music);
+    } else if (song) plug_mark_song_bad(song);
+}
+
+void plug_prev_song(void)
+{
+    size_t next_index = plug_pull_prev_song();
+    Song* song = plug_get_nth_song(next_index);
+#ifdef DEBUG
+    if (!song) TraceLog(LOG_ERROR, "Prev song is NULL, curr: %zu", next_index);
+#endif
+    if (song && plug_load_music(song)) {
+        plug->pl.prev = next_index;
+        TraceLog(LOG_INFO, "Set curr to: %zu", plug->pl.curr = next_index);
+        PlayMusicStream(plug->curr_music);
+    } else if (song) plug_mark_song_bad(song);
 }
 
 bool plug_play_next_song(void)
 {
     plug_print_songs();
 
-    size_t next_index = plug_pull_next_song();
+    plug_unload_music();
 
-    Song* next_song = plug_get_nth_song(next_index);
-    if (next_song) {
-        plug_unload_music();
+    // Anything the pre-flight check didn't catch gets marked here, and we move on to the next one
+    for (size_t tries = 0; tries < plug->pl.count; ++tries) {
+        size_t next_index = plug_pull_next_song();
+
+        Song* next_song = plug_get_nth_song(next_index);
+        if (!next_song) break;
 
         if (plug_load_music(next_song)) {
             plug->pl.prev = plug->pl.curr;
             plug->pl.curr = next_index;
-        } else {
-            TraceLog(LOG_ERROR, "Couldn't load music from file: %s", next_song);
-            return false;
+            return true;
         }
+
+        TraceLog(LOG_ERROR, "Couldn't load music from file: %s", next_song->path);
+        plug_mark_song_bad(next_song);
+        plug->pl.curr = next_index;
     }
 
-    return true;
+    return false;
 }
 
 bool plug_load_music(Song* song)
@@ -726,13 +1529,30 @@ bool plug_load_music(Song* song)
     TraceLog(LOG_INFO, "Passed file format: %s", song->path);
 #endif
 
-    Music m = LoadMusicStream(song->path);
+    const char* path = song->path;
+
+    // Modules play live until their rendered copy is cached, see plug_module_render_submit()
+    char rendered_path[TEXT_CAP];
+    uint64_t module_hash = 0;
+    if (is_module(path)) {
+        if (plug_module_cache_lookup(song, rendered_path, &module_hash)) path = rendered_path;
+        else if (module_hash) plug_module_render_submit(song, module_hash, rendered_path);
+    }
+
+    // Transcoded copies are cheaper to decode, see plug_transcode_schedule()
+    char transcoded_path[TEXT_CAP];
+    if (path == song->path && plug_transcode_lookup(path, transcoded_path)) path = transcoded_path;
+
+    Music_Data data = {0};
+    Music m = music_data_open(path, &data)
+        ? load_music_from_data(path, &data)
+        : (Music) {0};
 
     if (m.frameCount != 0) {
         SetMusicVolume(m, plug->music_volume);
 
-        if (IsMusicStreamPlaying(plug->curr_music) && plug->music_loaded)
-            plug_unload_music();
+        // Paused streams too, otherwise their backing memory would leak
+        if (plug->music_loaded) plug_unload_music();
 
         plug->app_state = MAIN_SCREEN;
 
@@ -748,6 +1568,7 @@ bool plug_load_music(Song* song)
 
         plug->pl.prev_song = *plug_get_curr_song();
         song->times_played++;
+        plug_transcode_played(song);
 
 #ifdef DEBUG
         TraceLog(LOG_INFO, "Assigned song_name successfully: %s", plug->song_name.text);
@@ -755,24 +1576,232 @@ bool plug_load_music(Song* song)
 #endif
 
         plug->curr_music = m;
+        plug->curr_music_data = data;
+        plug->null_sink_time = 0.f;
+        plug_attach_music(m);
         PlayMusicStream(m);
         return true;
     } else {
         UnloadMusicStream(m);
+        music_data_close(&data);
         return false;
     }
 }
 
-void plug_print_songs(void)
+// Reads the whole file up front so refills don't go through read() a chunk at a time. Not a
+// mapping, touching a mapped page past the end of a file truncated since is a SIGBUS.
+bool music_data_open(const char* path, Music_Data* data)
 {
-    for (size_t i = 0; i < plug->pl.count; ++i)
-        printf("playlist[%zu] = %s\n", i, plug->pl.songs[i].path);
+    // LoadFileData() sizes with an int
+    struct stat st;
+    if (stat(path, &st) < 0 || st.st_size <= 0 || st.st_size > INT_MAX) return false;
+
+    int size = 0;
+    data->data = LoadFileData(path, &size);
+    data->size = size;
+    if (data->data && size == 0) music_data_close(data);
+    return data->data != NULL;
 }
 
-Song new_song(const char* file_path, size_t times_played)
+void music_data_close(Music_Data* data)
 {
-    Song new_song;
-    new_song.times_played = times_played;
+    if (!data->data) return;
+    UnloadFileData(data->data);
+    *data = (Music_Data) {0};
+}
+
+Music load_music_from_data(const char* path, const Music_Data* data)
+{
+    // LoadMusicStreamFromMemory() only knows about lowercase (or fully uppercase) extensions
+    char ext[16] = {0};
+    const char* dot = strrchr(path, '.');
+    for (size_t i = 0; dot && dot[i] && i < sizeof(ext) - 1; ++i)
+        ext[i] = (dot[i] >= 'A' && dot[i] <= 'Z') ? dot[i] - 'A' + 'a' : dot[i];
+
+    return LoadMusicStreamFromMemory(ext, data->data, data->size);
+}
+
+// Bytes taken by the ID3v2 tag an mp3 may start with, 0 if there is none. The size field
+// is syncsafe (7 bits per byte) and leaves out the 10 byte header and the optional footer.
+size_t id3v2_size(const unsigned char* data, size_t size)
+{
+    if (size < 10 || memcmp(data, "ID3", 3) != 0) return 0;
+    if ((data[6] | data[7] | data[8] | data[9]) & 0x80) return 0;
+
+    const size_t tag = ((size_t) data[6] << 21) | ((size_t) data[7] << 14) | ((size_t) data[8] << 7) | data[9];
+    return 10 + tag + ((data[5] & 0x10) ? 10 : 0);
+}
+
+#ifdef STREAM_DECODE
+Decoder* decoder_open(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+    if (!ext) return NULL;
+
+    enum Decoder_Format format;
+    if (strcasecmp(ext, ".wav") == 0) format = DECODER_WAV;
+    else if (strcasecmp(ext, ".mp3") == 0) format = DECODER_MP3;
+    else if (strcasecmp(ext, ".ogg") == 0) format = DECODER_OGG;
+    else if (strcasecmp(ext, ".qoa") == 0) format = DECODER_QOA;
+    else return NULL;
+
+    Decoder* dec = calloc(1, sizeof(*dec));
+    assert(dec != NULL && "Buy more RAM lol");
+    dec->format = format;
+
+    bool ok = false;
+    switch (format) {
+    case DECODER_WAV:
+        ok = drwav_init_file(&dec->wav, path, NULL);
+        if (ok) {
+            dec->channels = dec->wav.channels;
+            dec->sample_rate = dec->wav.sampleRate;
+        }
+        break;
+    case DECODER_MP3:
+        // An ID3v2 tag is skipped like any other bytes before the first frame
+        ok = drmp3_init_file(&dec->mp3, path, NULL);
+        if (ok) {
+            dec->channels = dec->mp3.channels;
+            dec->sample_rate = dec->mp3.sampleRate;
+        }
+        break;
+    case DECODER_OGG: {
+        int error = 0;
+        dec->ogg = stb_vorbis_open_filename(path, &error, NULL);
+        ok = dec->ogg != NULL;
+        if (ok) {
+            const stb_vorbis_info info = stb_vorbis_get_info(dec->ogg);
+            dec->channels = info.channels;
+            dec->sample_rate = info.sample_rate;
+        }
+    } break;
+    case DECODER_QOA: {
+        // The file header and the first frame's header, which has the channels and rate
+        unsigned char head[QOA_MIN_FILESIZE];
+        FILE* file = fopen(path, "rb");
+        const unsigned int offset = file && fread(head, 1, sizeof(head), file) == sizeof(head)
+            ? qoa_decode_header(head, sizeof(head), &dec->qoa.desc)
+            : 0;
+        ok = offset > 0 && fseek(file, offset, SEEK_SET) == 0;
+        if (ok) {
+            dec->channels = dec->qoa.desc.channels;
+            dec->sample_rate = dec->qoa.desc.samplerate;
+            dec->qoa.file = file;
+            dec->qoa.bytes = malloc(qoa_max_frame_size(&dec->qoa.desc));
+            dec->qoa.frame = malloc(QOA_FRAME_LEN*DECODER_MAX_CHANNELS*sizeof(*dec->qoa.frame));
+            assert(dec->qoa.bytes != NULL && dec->qoa.frame != NULL && "Buy more RAM lol");
+        } else if (file) {
+            fclose(file);
+        }
+    } break;
+    }
+
+    if (!ok) {
+        free(dec);
+        return NULL;
+    }
+    if (dec->channels == 0 || dec->channels > DECODER_MAX_CHANNELS || dec->sample_rate == 0) {
+        decoder_close(dec);
+        return NULL;
+    }
+    return dec;
+}
+
+// Counting mp3 frames walks the frame headers of the whole file, call it only when needed
+uint64_t decoder_frame_count(Decoder* dec)
+{
+    switch (dec->format) {
+    case DECODER_WAV: return dec->wav.totalPCMFrameCount;
+    case DECODER_MP3: return drmp3_get_pcm_frame_count(&dec->mp3);
+    case DECODER_OGG: return stb_vorbis_stream_length_in_samples(dec->ogg);
+    case DECODER_QOA: return dec->qoa.desc.samples;
+    }
+    return 0;
+}
+
+// Reads up to `frames` interleaved frames into `out`, fewer only at the end of the stream
+size_t decoder_read(Decoder* dec, short* out, size_t frames)
+{
+    switch (dec->format) {
+    case DECODER_WAV: return drwav_read_pcm_frames_s16(&dec->wav, frames, out);
+    case DECODER_MP3: return drmp3_read_pcm_frames_s16(&dec->mp3, frames, out);
+    case DECODER_OGG: {
+        const int n = MIN(frames, (size_t) INT_MAX / dec->channels)*dec->channels;
+        return stb_vorbis_get_samples_short_interleaved(dec->ogg, dec->channels, out, n);
+    }
+    case DECODER_QOA: {
+        size_t done = 0;
+        while (done < frames) {
+            if (dec->qoa.pos == dec->qoa.len) {
+                // Every frame starts with its size in bytes, big endian at offset 6
+                unsigned char* bytes = dec->qoa.bytes;
+                if (fread(bytes, 1, 8, dec->qoa.file) != 8) break;
+                const unsigned int size = (bytes[6] << 8) | bytes[7];
+                if (size <= 8 || size > qoa_max_frame_size(&dec->qoa.desc)) break;
+                if (fread(bytes + 8, 1, size - 8, dec->qoa.file) != size - 8) break;
+
+                unsigned int len = 0;
+                if (qoa_decode_frame(bytes, size, &dec->qoa.desc, dec->qoa.frame, &len) == 0 || len == 0) break;
+                dec->qoa.len = len;
+                dec->qoa.pos = 0;
+            }
+
+            const size_t n = MIN(frames - done, (size_t) (dec->qoa.len - dec->qoa.pos));
+            memcpy(out + done*dec->channels, dec->qoa.frame + dec->qoa.pos*dec->channels,
+                   n*dec->channels*sizeof(*out));
+            done += n;
+            dec->qoa.pos += n;
+        }
+        return done;
+    }
+    }
+    return 0;
+}
+
+void decoder_close(Decoder* dec)
+{
+    switch (dec->format) {
+    case DECODER_WAV: drwav_uninit(&dec->wav); break;
+    case DECODER_MP3: drmp3_uninit(&dec->mp3); break;
+    case DECODER_OGG: stb_vorbis_close(dec->ogg); break;
+    case DECODER_QOA:
+        fclose(dec->qoa.file);
+        free(dec->qoa.bytes);
+        free(dec->qoa.frame);
+        break;
+    }
+    free(dec);
+}
+#endif
+
+bool plug_push_song(const char* path)
+{
+    if (!is_music(path)) {
+        TraceLog(LOG_ERROR, "Couldn't load music from file: %s", path);
+        return false;
+    }
+
+    Song song = new_song(path, 0);
+    song.id = ++plug->pl.last_id;
+    DA_PUSH(plug->pl, song);
+#ifdef DEBUG
+    TraceLog(LOG_INFO, "Pushed into the playlist this one: %s", path);
+    TraceLog(LOG_INFO, "Music count in the vm array: %zu\n", plug->pl.count);
+#endif
+    return true;
+}
+
+void plug_print_songs(void)
+{
+    for (size_t i = 0; i < plug->pl.count; ++i)
+        printf("playlist[%zu] = %s\n", i, plug->pl.songs[i].path);
+}
+
+Song new_song(const char* file_path, size_t times_played)
+{
+    Song new_song = {0};
+    new_song.times_played = times_played;
 
     if (strlen(file_path) > TEXT_CAP)
         TraceLog(LOG_ERROR, "file path length is greater than supported, truncating..");
@@ -786,15 +1815,37 @@ Song new_song(const char* file_path, size_t times_played)
     return new_song;
 }
 
+// Not using IsFileExtension() here: it lowercases into a static buffer,
+// and this gets called from the playlist import threads
 bool is_music(const char* path)
 {
+    const char* ext = strrchr(path, '.');
+    if (!ext) return false;
+
     for (size_t i = 0; i < SUPPORTED_FORMATS_CAP; ++i)
-        if (IsFileExtension(path, SUPPORTED_FORMATS[i]))
+        if (strcasecmp(ext, SUPPORTED_FORMATS[i]) == 0)
             return true;
 
     return false;
 }
 
+bool is_module(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+    return ext && (strcasecmp(ext, ".xm") == 0 || strcasecmp(ext, ".mod") == 0);
+}
+
+bool is_playlist(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+    return ext && (strcasecmp(ext, ".m3u") == 0 || strcasecmp(ext, ".m3u8") == 0 || strcasecmp(ext, ".pls") == 0);
+}
+
+bool is_song_skipped(const Song* song)
+{
+    return song->duplicate_of != 0 || song->check_state == CHECK_BAD || song->gone;
+}
+
 bool is_mouse_on_track(Vector2 mouse_pos, Seek_Track seek_track)
 {
     const float track_pad = seek_track.thickness*2;
@@ -827,3 +1878,2925 @@ void get_song_name(const char* input, char* o, size_t o_n)
         o[end - i - 1] = t;
     }
 }
+
+void plug_ctl_start(void)
+{
+    Ctl_Server* ctl = &plug->ctl;
+    if (ctl->started) return;
+
+    if (!ctl_socket_addr(&ctl->addr)) {
+        TraceLog(LOG_ERROR, "CTL: socket path %s is too long", ctl->addr.sun_path);
+        return;
+    }
+
+    ctl->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ctl->listen_fd < 0) {
+        TraceLog(LOG_ERROR, "CTL: could not create socket: %s", strerror(errno));
+        return;
+    }
+
+    // Another player answering there keeps its socket, only a stale one left by a crash is removed
+    const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        const bool taken = connect(probe, (struct sockaddr*) &ctl->addr, sizeof(ctl->addr)) == 0;
+        const bool stale = !taken && errno == ECONNREFUSED;
+        close(probe);
+        if (taken) {
+            TraceLog(LOG_WARNING, "CTL: another player is listening on %s, not taking commands", ctl->addr.sun_path);
+            close(ctl->listen_fd);
+            return;
+        }
+        if (stale) unlink(ctl->addr.sun_path);
+    }
+
+    if (bind(ctl->listen_fd, (struct sockaddr*) &ctl->addr, sizeof(ctl->addr)) < 0
+    ||  listen(ctl->listen_fd, 4) < 0) {
+        TraceLog(LOG_ERROR, "CTL: could not listen on %s: %s", ctl->addr.sun_path, strerror(errno));
+        close(ctl->listen_fd);
+        return;
+    }
+
+    atomic_store(&ctl->running, true);
+    if (pthread_create(&ctl->thread, NULL, ctl_thread, ctl) != 0) {
+        TraceLog(LOG_ERROR, "CTL: could not spawn control thread");
+        close(ctl->listen_fd);
+        return;
+    }
+
+    ctl->started = true;
+    TraceLog(LOG_INFO, "CTL: listening on %s", ctl->addr.sun_path);
+}
+
+void plug_ctl_stop(void)
+{
+    Ctl_Server* ctl = &plug->ctl;
+    if (!ctl->started) return;
+
+    atomic_store(&ctl->running, false);
+    pthread_join(ctl->thread, NULL);
+    close(ctl->listen_fd);
+    ctl->started = false;
+}
+
+void plug_ctl_publish_state(void)
+{
+    Ctl_State* st = &plug->ctl.state;
+    const Song* curr_song = plug_get_curr_song();
+
+    pthread_mutex_lock(&plug->ctl.state_lock);
+        st->music_loaded = plug->music_loaded;
+        st->music_paused = plug->music_paused;
+        st->curr = plug->pl.curr;
+        st->count = plug->pl.count;
+        st->length = plug->pl.length;
+        st->time_played = plug->pl.time_played;
+        st->music_volume = plug->music_volume;
+        strcpy(st->path, curr_song ? curr_song->path : "");
+    pthread_mutex_unlock(&plug->ctl.state_lock);
+}
+
+void plug_handle_ctl_commands(void)
+{
+    Ctl_Queue* q = &plug->ctl.queue;
+    const size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (head == tail) return;
+
+    bool added = false;
+    for (; head != tail; ++head) {
+        Ctl_Cmd* cmd = &q->cmds[head & (CTL_QUEUE_CAP - 1)];
+        switch (cmd->type) {
+        case CTL_NOP: break;
+
+        case CTL_ADD:
+            added |= DirectoryExists(cmd->path) ? plug_library_add(cmd->path) : plug_push_song(cmd->path);
+            free(cmd->path);
+            cmd->path = NULL;
+            break;
+
+        case CTL_PLAY: if (plug->music_loaded && plug->music_paused) {
+            plug->music_paused = false;
+            ResumeMusicStream(plug->curr_music);
+        } break;
+
+        case CTL_PAUSE: if (plug->music_loaded && !plug->music_paused) {
+            plug->music_paused = true;
+            PauseMusicStream(plug->curr_music);
+        } break;
+
+        case CTL_NEXT: if (plug->pl.count > 0) plug_next_song(); break;
+        case CTL_PREV: if (plug->pl.count > 0) plug_prev_song(); break;
+
+        case CTL_SEEK: if (plug->music_loaded) {
+            plug_music_seek(MIN(MAX(cmd->arg, 0.f), plug->pl.length));
+        } break;
+
+        case CTL_VOLUME:
+            plug->music_volume = MIN(MAX(cmd->arg, 0.f), 1.f);
+            if (plug->music_loaded && !plug->music_muted)
+                SetMusicVolume(plug->curr_music, plug->music_volume);
+            break;
+
+        case CTL_IMPORT:
+            added |= plug_import_playlist(cmd->path);
+            free(cmd->path);
+            cmd->path = NULL;
+            break;
+
+        case CTL_EXPORT:
+            plug_export_playlist(cmd->path);
+            free(cmd->path);
+            cmd->path = NULL;
+            break;
+
+        case CTL_SPEED: plug_set_music_speed(cmd->arg); break;
+
+        default: assert(NULL && "Unexpected case");
+        }
+    }
+
+    atomic_store_explicit(&q->head, head, memory_order_release);
+
+    if (added && !plug->music_loaded && plug->pl.count > 0) plug_load_music(&plug->pl.songs[0]);
+}
+
+static bool ctl_push(Ctl_Server* ctl, Ctl_Cmd cmd)
+{
+    Ctl_Queue* q = &ctl->queue;
+    const size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    // Queue is full, wait for the main loop to drain it
+    while (tail - atomic_load_explicit(&q->head, memory_order_acquire) >= CTL_QUEUE_CAP) {
+        if (!atomic_load(&ctl->running)) return false;
+        nanosleep(&(struct timespec) { .tv_nsec = 1000000 }, NULL);
+    }
+
+    q->cmds[tail & (CTL_QUEUE_CAP - 1)] = cmd;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static void ctl_reply(int fd, const char* msg)
+{
+    for (size_t n = strlen(msg); n > 0;) {
+        const ssize_t w = write(fd, msg, n);
+        if (w <= 0) return;
+        msg += w;
+        n -= w;
+    }
+}
+
+// Line protocol, one command per line:
+//   add <path> | import <path> | export <path> | play | pause | next | prev
+//   seek <secs> | volume <0..1> | speed <0.5..3> | nop | ping | state
+static void ctl_exec_line(Ctl_Server* ctl, int fd, char* line)
+{
+    char* arg = strchr(line, ' ');
+    if (arg) *arg++ = '\0';
+
+    Ctl_Cmd cmd = {0};
+    if      (strcmp(line, "nop") == 0)    cmd.type = CTL_NOP;
+    else if (strcmp(line, "play") == 0)   cmd.type = CTL_PLAY;
+    else if (strcmp(line, "pause") == 0)  cmd.type = CTL_PAUSE;
+    else if (strcmp(line, "next") == 0)   cmd.type = CTL_NEXT;
+    else if (strcmp(line, "prev") == 0)   cmd.type = CTL_PREV;
+    else if (strcmp(line, "seek") == 0   && arg) cmd = (Ctl_Cmd) { .type = CTL_SEEK,   .arg = strtof(arg, NULL) };
+    else if (strcmp(line, "volume") == 0 && arg) cmd = (Ctl_Cmd) { .type = CTL_VOLUME, .arg = strtof(arg, NULL) };
+    else if (strcmp(line, "speed") == 0  && arg) cmd = (Ctl_Cmd) { .type = CTL_SPEED,  .arg = strtof(arg, NULL) };
+    else if ((strcmp(line, "add") == 0 || strcmp(line, "import") == 0 || strcmp(line, "export") == 0) && arg) {
+        cmd.type = line[0] == 'a' ? CTL_ADD : line[0] == 'i' ? CTL_IMPORT : CTL_EXPORT;
+        cmd.path = strdup(arg);
+        assert(cmd.path != NULL && "Buy more RAM lol");
+    } else if (strcmp(line, "ping") == 0) {
+        ctl_reply(fd, "pong\n");
+        return;
+    } else if (strcmp(line, "state") == 0) {
+        char buf[TEXT_CAP + 128];
+        pthread_mutex_lock(&ctl->state_lock);
+            const Ctl_State* st = &ctl->state;
+            snprintf(buf, sizeof(buf), "state %s %zu %zu %.3f %.3f %.2f %s\n",
+                     !st->music_loaded ? "idle" : st->music_paused ? "paused" : "playing",
+                     st->curr, st->count, st->time_played, st->length, st->music_volume, st->path);
+        pthread_mutex_unlock(&ctl->state_lock);
+        ctl_reply(fd, buf);
+        return;
+    } else {
+        ctl_reply(fd, "err unknown command\n");
+        return;
+    }
+
+    if (!ctl_push(ctl, cmd)) free(cmd.path);
+}
+
+static void ctl_serve_client(Ctl_Server* ctl, int fd)
+{
+    char buf[TEXT_CAP*8];
+    size_t len = 0;
+
+    while (atomic_load(&ctl->running)) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        const int ready = poll(&pfd, 1, CTL_POLL_MS);
+        if (ready < 0 && errno != EINTR) return;
+        if (ready <= 0) continue;
+
+        const ssize_t n = read(fd, buf + len, sizeof(buf) - len - 1);
+        if (n <= 0) return;
+        len += n;
+
+        char* line = buf;
+        for (char* nl; (nl = memchr(line, '\n', buf + len - line)) != NULL; line = nl + 1) {
+            *nl = '\0';
+            if (nl > line && nl[-1] == '\r') nl[-1] = '\0';
+            if (*line) ctl_exec_line(ctl, fd, line);
+        }
+
+        len = buf + len - line;
+        memmove(buf, line, len);
+        if (len == sizeof(buf) - 1) {
+            TraceLog(LOG_ERROR, "CTL: command line too long, dropping client");
+            return;
+        }
+    }
+}
+
+void* ctl_thread(void* arg)
+{
+    Ctl_Server* ctl = arg;
+
+    while (atomic_load(&ctl->running)) {
+        struct pollfd pfd = { .fd = ctl->listen_fd, .events = POLLIN };
+        if (poll(&pfd, 1, CTL_POLL_MS) <= 0) continue;
+
+        const int fd = accept(ctl->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+
+        ctl_serve_client(ctl, fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+// Parses one playlist line into `o`, resolving it against the playlist's directory.
+// Returns false for comments, blank lines and anything that isn't a supported music file.
+static bool playlist_parse_line(const Playlist_Chunk* chunk, const char* line, size_t n, char* o)
+{
+    while (n > 0 && (line[n - 1] == '\r' || line[n - 1] == ' ' || line[n - 1] == '\t')) n--;
+    while (n > 0 && (*line == ' ' || *line == '\t')) line++, n--;
+    if (n == 0) return false;
+
+    if (chunk->format == PLAYLIST_M3U) {
+        if (*line == '#') return false;
+        // UTF-8 BOM in the first line of .m3u8 files
+        if (n >= 3 && memcmp(line, "\xEF\xBB\xBF", 3) == 0) line += 3, n -= 3;
+    } else {
+        // FileN=path, every other key is ignored
+        if (n < 5 || strncasecmp(line, "file", 4) != 0) return false;
+        const char* eq = memchr(line, '=', n);
+        if (!eq) return false;
+        n -= eq + 1 - line;
+        line = eq + 1;
+    }
+
+    if (n >= 7 && memcmp(line, "file://", 7) == 0) line += 7, n -= 7;
+    if (n == 0) return false;
+
+    size_t len = 0;
+    if (*line != DELIM && chunk->base_dir_len > 0) {
+        len = MIN(chunk->base_dir_len, TEXT_CAP - 1);
+        memcpy(o, chunk->base_dir, len);
+        if (len < TEXT_CAP - 1) o[len++] = DELIM;
+    }
+
+    n = MIN(n, TEXT_CAP - 1 - len);
+    memcpy(o + len, line, n);
+    o[len + n] = '\0';
+
+    return is_music(o);
+}
+
+void* playlist_chunk_thread(void* arg)
+{
+    Playlist_Chunk* chunk = arg;
+    char path[TEXT_CAP];
+
+    chunk->count = 0;
+    for (const char* line = chunk->begin; line < chunk->end;) {
+        const char* nl = memchr(line, '\n', chunk->end - line);
+        const char* line_end = nl ? nl : chunk->end;
+
+        if (playlist_parse_line(chunk, line, line_end - line, path)) {
+            if (chunk->out) {
+                Song* out = &chunk->out[chunk->count];
+                memcpy(out->path, path, strlen(path) + 1);
+                out->times_played = 0;
+                out->fp_state = FP_NONE;
+                out->duplicate_of = 0;
+                out->check_state = CHECK_NONE;
+            }
+            chunk->count++;
+        }
+
+        line = line_end + 1;
+    }
+
+    return NULL;
+}
+
+static void playlist_run_chunks(Playlist_Chunk* chunks, size_t n)
+{
+    pthread_t threads[PLAYLIST_IMPORT_THREADS_CAP];
+    bool spawned[PLAYLIST_IMPORT_THREADS_CAP] = {0};
+
+    // The last chunk is parsed on the calling thread
+    for (size_t i = 0; i + 1 < n; ++i)
+        spawned[i] = pthread_create(&threads[i], NULL, playlist_chunk_thread, &chunks[i]) == 0;
+
+    playlist_chunk_thread(&chunks[n - 1]);
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+        if (spawned[i]) pthread_join(threads[i], NULL);
+        else playlist_chunk_thread(&chunks[i]);
+    }
+}
+
+bool plug_import_playlist(const char* path)
+{
+    const double start = GetTime();
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        TraceLog(LOG_ERROR, "Couldn't open playlist %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    const size_t size = st.st_size;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        TraceLog(LOG_ERROR, "Couldn't map playlist %s: %s", path, strerror(errno));
+        return false;
+    }
+    // Advice values aren't flags, one call each
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+    madvise((void*) data, size, MADV_WILLNEED);
+
+    const char* slash = strrchr(path, DELIM);
+
+    // Split on line boundaries, roughly one chunk per core
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t n = MIN((size_t) MAX(cores, 1), PLAYLIST_IMPORT_THREADS_CAP);
+    n = MAX(MIN(n, size / (64*1024)), 1);
+
+    Playlist_Chunk chunks[PLAYLIST_IMPORT_THREADS_CAP];
+    const char* begin = data;
+    for (size_t i = 0; i < n; ++i) {
+        const char* end = i + 1 == n ? data + size : data + size / n * (i + 1);
+        if (end < begin) end = begin;
+        const char* nl = end < data + size ? memchr(end, '\n', data + size - end) : NULL;
+        if (i + 1 < n) end = nl ? nl + 1 : data + size;
+
+        chunks[i] = (Playlist_Chunk) {
+            .begin = begin,
+            .end = end,
+            .format = IsFileExtension(path, ".pls") ? PLAYLIST_PLS : PLAYLIST_M3U,
+            .base_dir = path,
+            .base_dir_len = slash ? (size_t) (slash - path) : 0,
+        };
+        begin = end;
+    }
+
+    // First pass counts the entries so the playlist only has to grow once,
+    // the second one parses every chunk straight into its slice of the playlist
+    playlist_run_chunks(chunks, n);
+
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) total += chunks[i].count;
+    DA_RESERVE(plug->pl, total);
+
+    for (size_t i = 0, offset = plug->pl.count; i < n; offset += chunks[i++].count)
+        chunks[i].out = &plug->pl.songs[offset];
+
+    playlist_run_chunks(chunks, n);
+    for (size_t i = 0; i < total; ++i) plug->pl.songs[plug->pl.count + i].id = ++plug->pl.last_id;
+    plug->pl.count += total;
+
+    munmap((void*) data, size);
+
+    TraceLog(LOG_INFO, "Imported %zu songs from %s in %.3f seconds", total, path, GetTime() - start);
+    return total > 0;
+}
+
+bool plug_export_playlist(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        TraceLog(LOG_ERROR, "Couldn't open %s for writing: %s", path, strerror(errno));
+        return false;
+    }
+
+    static char buf[1 << 16];
+    setvbuf(f, buf, _IOFBF, sizeof(buf));
+
+    const bool pls = IsFileExtension(path, ".pls");
+    fputs(pls ? "[playlist]\n" : "#EXTM3U\n", f);
+
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        if (pls) fprintf(f, "File%zu=%s\n", i + 1, plug->pl.songs[i].path);
+        else {
+            fputs(plug->pl.songs[i].path, f);
+            fputc('\n', f);
+        }
+    }
+
+    if (pls) fprintf(f, "NumberOfEntries=%zu\nVersion=2\n", plug->pl.count);
+
+    const bool ok = !ferror(f);
+    if (fclose(f) != 0 || !ok) {
+        TraceLog(LOG_ERROR, "Couldn't write playlist %s", path);
+        return false;
+    }
+
+    TraceLog(LOG_INFO, "Exported %zu songs to %s", plug->pl.count, path);
+    return true;
+}
+
+static void worker_pool_start(Worker_Pool* pool, size_t n, void* (*thread)(void*))
+{
+    if (pool->count > 0) return;
+
+    pool->stopping = false;
+    for (size_t i = 0; i < n; ++i) {
+        if (pthread_create(&pool->threads[pool->count], NULL, thread, pool) != 0) {
+            TraceLog(LOG_ERROR, "WORKERS: could not spawn worker thread");
+            break;
+        }
+        pool->count++;
+    }
+}
+
+static void worker_pool_poll(Worker_Pool* pool)
+{
+    pthread_mutex_lock(&pool->lock);
+        Job* finished = pool->finished;
+        pool->finished = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    // Finished jobs are stacked, restore submission order
+    Job* ordered = NULL;
+    while (finished) {
+        Job* next = finished->next;
+        finished->next = ordered;
+        ordered = finished;
+        finished = next;
+    }
+
+    while (ordered) {
+        Job* next = ordered->next;
+        pthread_mutex_lock(&pool->lock);
+            pool->in_flight--;
+        pthread_mutex_unlock(&pool->lock);
+        ordered->done(ordered);
+        ordered = next;
+    }
+}
+
+static void worker_pool_stop(Worker_Pool* pool)
+{
+    if (pool->count == 0) return;
+
+    pthread_mutex_lock(&pool->lock);
+        pool->stopping = true;
+        pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->count; ++i) pthread_join(pool->threads[i], NULL);
+    pool->count = 0;
+
+    // Whatever didn't get to run is handed back cancelled, while this library is still loaded
+    for (Job* job = pool->pending; job;) {
+        Job* next = job->next;
+        job->cancelled = true;
+        job->next = pool->finished;
+        pool->finished = job;
+        job = next;
+    }
+    pool->pending = pool->pending_tail = NULL;
+
+    worker_pool_poll(pool);
+}
+
+static void worker_pool_submit(Worker_Pool* pool, Job* job)
+{
+    job->next = NULL;
+    job->cancelled = false;
+
+    pthread_mutex_lock(&pool->lock);
+        if (pool->pending_tail) pool->pending_tail->next = job;
+        else pool->pending = job;
+        pool->pending_tail = job;
+        pool->in_flight++;
+        pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void plug_workers_start(void)
+{
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    // A single worker under replay, so jobs finish in the order they were submitted
+    const size_t n = replay_path ? 1 : MIN((size_t) MAX(cores - 1, 1), WORKERS_CAP);
+
+    worker_pool_start(&plug->workers, n, worker_thread);
+    TraceLog(LOG_INFO, "WORKERS: started %zu worker threads", plug->workers.count);
+
+    if (plug->transcode_budget > 0) worker_pool_start(&plug->idle_workers, 1, idle_worker_thread);
+}
+
+void plug_workers_stop(void)
+{
+    worker_pool_stop(&plug->workers);
+    worker_pool_stop(&plug->idle_workers);
+}
+
+void plug_workers_submit(Job* job)
+{
+    worker_pool_submit(&plug->workers, job);
+}
+
+// For work the player is about to wait on, jumps ahead of the background passes
+void plug_workers_submit_front(Job* job)
+{
+    Worker_Pool* pool = &plug->workers;
+    job->cancelled = false;
+
+    pthread_mutex_lock(&pool->lock);
+        job->next = pool->pending;
+        pool->pending = job;
+        if (!pool->pending_tail) pool->pending_tail = job;
+        pool->in_flight++;
+        pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Runs only when nothing else wants the CPU, for work nobody is waiting on
+void plug_idle_workers_submit(Job* job)
+{
+    worker_pool_submit(&plug->idle_workers, job);
+}
+
+void plug_workers_poll(void)
+{
+    worker_pool_poll(&plug->workers);
+    worker_pool_poll(&plug->idle_workers);
+}
+
+// The replay calls this between frames, so background work lands on the same frame every time
+void plug_workers_drain(void)
+{
+    Worker_Pool* pools[] = {&plug->workers, &plug->idle_workers};
+    for (;;) {
+        plug_workers_poll();
+
+        size_t in_flight = 0;
+        for (size_t i = 0; i < DA_LEN(pools); ++i) {
+            pthread_mutex_lock(&pools[i]->lock);
+                if (pools[i]->count > 0) in_flight += pools[i]->in_flight;
+            pthread_mutex_unlock(&pools[i]->lock);
+        }
+
+        if (in_flight == 0) break;
+        usleep(1000);
+    }
+}
+
+void* worker_thread(void* arg)
+{
+    Worker_Pool* pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->pending && !pool->stopping) pthread_cond_wait(&pool->cond, &pool->lock);
+        if (pool->stopping) break;
+
+        Job* job = pool->pending;
+        pool->pending = job->next;
+        if (!pool->pending) pool->pending_tail = NULL;
+
+        pthread_mutex_unlock(&pool->lock);
+            job->run(job);
+        pthread_mutex_lock(&pool->lock);
+
+        job->next = pool->finished;
+        pool->finished = job;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+void* idle_worker_thread(void* arg)
+{
+#ifdef SCHED_IDLE
+    const struct sched_param param = {0};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0)
+#endif
+        setpriority(PRIO_PROCESS, 0, 19); // Per thread on Linux
+
+    return worker_thread(arg);
+}
+
+static double monotonic_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double thread_cpu_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// In-place iterative radix-2 FFT, n must be a power of two
+static void fft(float* re, float* im, size_t n)
+{
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+
+    for (size_t len = 2; len <= n; len <<= 1) {
+        const float ang = -2*PI / len;
+        const float wr = cosf(ang), wi = sinf(ang);
+        for (size_t i = 0; i < n; i += len) {
+            float cr = 1.f, ci = 0.f;
+            for (size_t k = 0; k < len/2; ++k) {
+                const size_t a = i + k, b = i + k + len/2;
+                const float tr = re[b]*cr - im[b]*ci;
+                const float ti = re[b]*ci + im[b]*cr;
+                re[b] = re[a] - tr; im[b] = im[a] - ti;
+                re[a] += tr;        im[a] += ti;
+                const float nr = cr*wr - ci*wi;
+                ci = cr*wi + ci*wr;
+                cr = nr;
+            }
+        }
+    }
+}
+
+// Pitch class of every FFT bin in the 55Hz..4kHz range, -1 for the rest
+static int fp_bin_class[FP_FRAME/2];
+static float fp_window[FP_FRAME];
+
+// Shared by every worker, filled exactly once
+static void fingerprint_init_tables(void)
+{
+    for (size_t i = 0; i < FP_FRAME; ++i)
+        fp_window[i] = .5f - .5f*cosf(2*PI*i / (FP_FRAME - 1));
+
+    for (size_t i = 0; i < FP_FRAME/2; ++i) {
+        const float freq = (float) i*FP_RATE / FP_FRAME;
+        if (freq < 55.f || freq > 4000.f) fp_bin_class[i] = -1;
+        else fp_bin_class[i] = ((int) lroundf(12*log2f(freq / 440.f)) % 12 + 12 + 9) % 12;
+    }
+}
+
+// Downmixes and resamples the start of the song to at most `cap` samples at FP_RATE
+#ifdef STREAM_DECODE
+static size_t fingerprint_decode(const char* path, float* mono, size_t cap, float* duration)
+{
+    Decoder* dec = decoder_open(path);
+    if (!dec) return 0;
+    *duration = (float) decoder_frame_count(dec) / dec->sample_rate;
+
+    // Only what's fingerprinted gets decoded, each output sample averages the frames
+    // that fall into it (or repeats the last one when upsampling)
+    short chunk[DECODER_CHUNK_FRAMES*DECODER_MAX_CHANNELS];
+    const double step = (double) dec->sample_rate / FP_RATE;
+    size_t count = 0;
+    uint64_t frame = 0;
+    float acc = 0.f;
+    size_t acc_count = 0;
+    for (size_t n; count < cap && (n = decoder_read(dec, chunk, DECODER_CHUNK_FRAMES)) > 0;) {
+        for (size_t i = 0; i < n && count < cap; ++i, ++frame) {
+            const size_t bin = frame / step;
+            if (bin != count) {
+                const float value = acc_count > 0 ? acc / acc_count : 0.f;
+                for (; count < bin && count < cap; ++count) mono[count] = value;
+                acc = 0.f;
+                acc_count = 0;
+                if (count >= cap) break;
+            }
+
+            for (size_t c = 0; c < dec->channels; ++c) acc += chunk[i*dec->channels + c] / 32768.f;
+            acc_count += dec->channels;
+        }
+    }
+    decoder_close(dec);
+    return count;
+}
+#else
+static float wave_sample(const Wave* wave, size_t i)
+{
+    switch (wave->sampleSize) {
+    case 8:  return (((unsigned char*) wave->data)[i] - 128) / 128.f;
+    case 16: return ((short*) wave->data)[i] / 32768.f;
+    case 32: return ((float*) wave->data)[i];
+    default: return 0.f;
+    }
+}
+
+// Without raylib's decoders around (see RAYLIB_SRC in the Makefile) the whole file is loaded
+static size_t fingerprint_decode(const char* path, float* mono, size_t cap, float* duration)
+{
+    Wave wave = LoadWave(path);
+    if (wave.frameCount == 0 || wave.sampleRate == 0) {
+        UnloadWave(wave);
+        return 0;
+    }
+
+    *duration = (float) wave.frameCount / wave.sampleRate;
+
+    const float step = (float) wave.sampleRate / FP_RATE;
+    const size_t count = MIN((size_t) (wave.frameCount / step), cap);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t from = i*step, to = MAX((size_t) ((i + 1)*step), from + 1);
+        float acc = 0.f;
+        for (size_t f = from; f < to && f < wave.frameCount; ++f)
+            for (size_t c = 0; c < wave.channels; ++c)
+                acc += wave_sample(&wave, f*wave.channels + c);
+        mono[i] = acc / ((to - from)*wave.channels);
+    }
+    UnloadWave(wave);
+    return count;
+}
+#endif
+
+// Chroma based fingerprint: the first FP_MAX_SECONDS of the song are downmixed and resampled
+// to FP_RATE, every frame's spectrum is folded into 12 pitch classes, and each frame is reduced
+// to 32 bits describing how neighbouring pitch classes and consecutive frames compare.
+// Robust to re-encoding and sample rate changes, which is what tells the copies apart.
+bool fingerprint_compute(const char* path, Fingerprint* fp)
+{
+    const size_t mono_cap = (size_t) FP_RATE*FP_MAX_SECONDS;
+    float* mono = malloc(mono_cap*sizeof(*mono));
+    assert(mono != NULL && "Buy more RAM lol");
+
+    const size_t mono_count = fingerprint_decode(path, mono, mono_cap, &fp->duration);
+    if (mono_count == 0) {
+        free(mono);
+        return false;
+    }
+
+    static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+    pthread_once(&tables_once, fingerprint_init_tables);
+
+    fp->count = mono_count >= FP_FRAME ? (mono_count - FP_FRAME) / FP_HOP + 1 : 0;
+    fp->frames = malloc(MAX(fp->count, 1)*sizeof(*fp->frames));
+    assert(fp->frames != NULL && "Buy more RAM lol");
+    memset(fp->chroma, 0, sizeof(fp->chroma));
+
+    float re[FP_FRAME], im[FP_FRAME];
+    float prev[12] = {0};
+    for (size_t frame = 0; frame < fp->count; ++frame) {
+        const float* in = mono + frame*FP_HOP;
+        for (size_t i = 0; i < FP_FRAME; ++i) {
+            re[i] = in[i]*fp_window[i];
+            im[i] = 0.f;
+        }
+        fft(re, im, FP_FRAME);
+
+        float chroma[12] = {0};
+        for (size_t i = 1; i < FP_FRAME/2; ++i)
+            if (fp_bin_class[i] >= 0) chroma[fp_bin_class[i]] += sqrtf(re[i]*re[i] + im[i]*im[i]);
+
+        float norm = 0.f;
+        for (size_t c = 0; c < 12; ++c) norm += chroma[c]*chroma[c];
+        norm = norm > 0.f ? 1.f / sqrtf(norm) : 0.f;
+
+        uint32_t bits = 0;
+        for (size_t c = 0; c < 12; ++c) {
+            chroma[c] *= norm;
+            fp->chroma[c] += chroma[c];
+        }
+        for (size_t c = 0; c < 12; ++c) {
+            bits |= (uint32_t) (chroma[c] > chroma[(c + 1) % 12]) << c;
+            bits |= (uint32_t) (chroma[c] > prev[c]) << (12 + c);
+            if (c < 8) bits |= (uint32_t) (chroma[c] > chroma[(c + 2) % 12]) << (24 + c);
+        }
+        fp->frames[frame] = bits;
+        memcpy(prev, chroma, sizeof(prev));
+    }
+    free(mono);
+
+    float norm = 0.f;
+    for (size_t c = 0; c < 12; ++c) norm += fp->chroma[c]*fp->chroma[c];
+    if (norm > 0.f) for (size_t c = 0; c < 12; ++c) fp->chroma[c] /= sqrtf(norm);
+
+    return fp->count > 0;
+}
+
+// 1 for identical fingerprints, 0 for unrelated ones
+float fingerprint_similarity(const Fingerprint* a, const Fingerprint* b)
+{
+    if (fabsf(a->duration - b->duration) > MAX(2.f, .02f*MAX(a->duration, b->duration))) return 0.f;
+
+    float dot = 0.f;
+    for (size_t c = 0; c < 12; ++c) dot += a->chroma[c]*b->chroma[c];
+    if (dot < FP_MIN_CHROMA_SIMILARITY) return 0.f;
+
+    float best = 1.f;
+    for (int offset = -FP_MAX_OFFSET; offset <= FP_MAX_OFFSET; ++offset) {
+        const size_t ai = offset > 0 ? offset : 0;
+        const size_t bi = offset < 0 ? -offset : 0;
+        if (ai >= a->count || bi >= b->count) continue;
+
+        const size_t overlap = MIN(a->count - ai, b->count - bi);
+        if (overlap < MIN(a->count, b->count) / 2) continue;
+
+        size_t errors = 0;
+        for (size_t i = 0; i < overlap; ++i)
+            errors += __builtin_popcount(a->frames[ai + i] ^ b->frames[bi + i]);
+
+        best = MIN(best, (float) errors / (32*overlap));
+    }
+
+    return 1.f - best;
+}
+
+// Pitch classes louder than average, similar songs land in the same or a neighbouring bucket
+static size_t fingerprint_key(const Fingerprint* fp)
+{
+    float mean = 0.f;
+    for (size_t c = 0; c < 12; ++c) mean += fp->chroma[c] / 12;
+
+    size_t key = 0;
+    for (size_t c = 0; c < 12; ++c) key |= (size_t) (fp->chroma[c] > mean) << c;
+    return key;
+}
+
+void fp_index_free(Fp_Index* index)
+{
+    for (size_t i = 0; i < index->count; ++i) free(index->items[i].frames);
+    for (size_t i = 0; i < FP_BUCKETS_CAP; ++i) free(index->buckets[i].items);
+    free(index->items);
+    memset(index, 0, sizeof(*index));
+}
+
+// Takes ownership of the fingerprint's frames
+void fp_index_insert(Fp_Index* index, Fingerprint fp)
+{
+    if (index->count >= index->cap) {
+        index->cap = index->cap == 0 ? DA_INIT_CAP : index->cap*2;
+        index->items = realloc(index->items, index->cap*sizeof(*index->items));
+        assert(index->items != NULL && "Buy more RAM lol");
+    }
+
+    Fp_Bucket* bucket = &index->buckets[fingerprint_key(&fp)];
+    if (bucket->count >= bucket->cap) {
+        bucket->cap = bucket->cap == 0 ? 16 : bucket->cap*2;
+        bucket->items = realloc(bucket->items, bucket->cap*sizeof(*bucket->items));
+        assert(bucket->items != NULL && "Buy more RAM lol");
+    }
+
+    bucket->items[bucket->count++] = index->count;
+    index->items[index->count++] = fp;
+}
+
+static int compare_ids(const void* a, const void* b)
+{
+    const size_t x = *(const size_t*) a, y = *(const size_t*) b;
+    return (x > y) - (x < y);
+}
+
+// Drops the fingerprints of the songs with these (sorted) ids, their slots stay as zero length
+// fingerprints that never match anything
+void fp_index_remove(Fp_Index* index, const size_t* ids, size_t n)
+{
+    if (n == 0) return;
+
+    for (size_t i = 0; i < index->count; ++i) {
+        Fingerprint* fp = &index->items[i];
+        if (fp->song_id == 0 || !bsearch(&fp->song_id, ids, n, sizeof(*ids), compare_ids)) continue;
+
+        free(fp->frames);
+        fp->frames = NULL;
+        fp->count = 0;
+        fp->song_id = 0;
+    }
+}
+
+// Probes the song's own bucket and the 12 buckets one bit away
+Fingerprint* fp_index_lookup(Fp_Index* index, const Fingerprint* fp)
+{
+    const size_t key = fingerprint_key(fp);
+
+    Fingerprint* best = NULL;
+    float best_similarity = 1.f - FP_MAX_BIT_ERROR;
+
+    for (size_t probe = 0; probe <= 12; ++probe) {
+        const Fp_Bucket* bucket = &index->buckets[probe == 0 ? key : key ^ ((size_t) 1 << (probe - 1))];
+        for (size_t i = 0; i < bucket->count; ++i) {
+            Fingerprint* other = &index->items[bucket->items[i]];
+            const float similarity = fingerprint_similarity(fp, other);
+            if (similarity >= best_similarity) {
+                best_similarity = similarity;
+                best = other;
+            }
+        }
+    }
+
+    return best;
+}
+
+static void fingerprint_job_run(Job* job_)
+{
+    Fingerprint_Job* job = (Fingerprint_Job*) job_;
+    const double start = thread_cpu_time();
+
+    job->fp.song_id = job->song_id;
+    if (!fingerprint_compute(job->path, &job->fp)) {
+        free(job->fp.frames);
+        job->fp.frames = NULL;
+        job->fp.count = 0;
+    }
+
+    job->cpu_time = thread_cpu_time() - start;
+}
+
+static void fingerprint_job_done(Job* job_)
+{
+    Fingerprint_Job* job = (Fingerprint_Job*) job_;
+    Fp_Index* index = &plug->fp;
+    Song* song = plug_find_song(job->song_id, job->song_hint);
+    // Changed on disk while this ran, the scheduler has it again
+    if (song && song->generation != job->generation) song = NULL;
+
+    if (job->job.cancelled) {
+        // Picked up again by the scheduler after the reload
+        if (song) {
+            song->fp_state = FP_NONE;
+            index->cursor = MIN(index->cursor, (size_t) (song - plug->pl.songs));
+        }
+    } else if (song) {
+        song->fp_state = FP_DONE;
+        index->tracks++;
+        index->cpu_time += job->cpu_time;
+
+        if (job->fp.count > 0) {
+            Fingerprint* original = fp_index_lookup(index, &job->fp);
+            const Song* original_song = original ? plug_find_song(original->song_id, original->song_hint) : NULL;
+            // Moved by a compaction, found by a scan this once
+            if (original_song) original->song_hint = original_song - plug->pl.songs;
+            if (original_song && original_song->check_state != CHECK_BAD) {
+                song->duplicate_of = original->song_id;
+                index->duplicates++;
+                TraceLog(LOG_INFO, "FINGERPRINT: %s is a duplicate of %s", song->path, original_song->path);
+            } else {
+                job->fp.song_hint = song - plug->pl.songs;
+                fp_index_insert(index, job->fp);
+                job->fp.frames = NULL;
+            }
+        }
+    }
+
+    free(job->fp.frames);
+    free(job);
+}
+
+void plug_fingerprint_schedule(void)
+{
+    Fp_Index* index = &plug->fp;
+    const size_t budget = plug->workers.count*2;
+
+    while (plug->workers.in_flight < budget && index->cursor < plug->pl.count) {
+        const size_t i = index->cursor++;
+        Song* song = &plug->pl.songs[i];
+        if (song->fp_state != FP_NONE) continue;
+
+        Fingerprint_Job* job = calloc(1, sizeof(*job));
+        assert(job != NULL && "Buy more RAM lol");
+        job->job.run = fingerprint_job_run;
+        job->job.done = fingerprint_job_done;
+        job->song_id = song->id;
+        job->song_hint = i;
+        job->generation = song->generation;
+        strcpy(job->path, song->path);
+
+        song->fp_state = FP_PENDING;
+        index->pass_logged = false;
+        plug_workers_submit(&job->job);
+    }
+
+    if (!index->pass_logged && index->cursor >= plug->pl.count && plug->workers.in_flight == 0 && index->tracks > 0) {
+        TraceLog(LOG_INFO, "FINGERPRINT: %zu tracks, %zu duplicates, %.1f tracks/min per core",
+                 index->tracks, index->duplicates, index->tracks*60.0 / MAX(index->cpu_time, 1e-9));
+        index->pass_logged = true;
+    }
+}
+
+// Replaces the current stream with another file of the same song, keeping the player's state
+bool plug_swap_music(const char* path, float position)
+{
+    Music_Data data = {0};
+    if (!music_data_open(path, &data)) return false;
+
+    Music m = load_music_from_data(path, &data);
+    if (m.frameCount == 0) {
+        UnloadMusicStream(m);
+        music_data_close(&data);
+        return false;
+    }
+
+    const bool paused = plug->music_paused;
+    plug_unload_music();
+
+    plug->curr_music = m;
+    plug->curr_music_data = data;
+    plug->music_loaded = true;
+    plug->pl.length = GetMusicTimeLength(m);
+
+    SetMusicVolume(m, plug->music_muted ? 0.f : plug->music_volume);
+    plug_attach_music(m);
+    PlayMusicStream(m);
+    plug_music_seek(MIN(position, plug->pl.length));
+    if (paused) PauseMusicStream(m);
+
+    return true;
+}
+
+// FNV-1a
+uint64_t hash_bytes(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void plug_init_cache_dir(void)
+{
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+
+    char base[TEXT_CAP];
+    if (xdg && *xdg) snprintf(base, sizeof(base), "%s", xdg);
+    else if (home && *home) snprintf(base, sizeof(base), "%s%c.cache", home, DELIM);
+    else snprintf(base, sizeof(base), "/tmp");
+
+    mkdir(base, 0755);
+    snprintf(plug->cache_dir, TEXT_CAP, "%.*s%c%s", TEXT_CAP - 32, base, DELIM, CACHE_DIR_NAME);
+
+    if (mkdir(plug->cache_dir, 0755) < 0 && errno != EEXIST) {
+        TraceLog(LOG_ERROR, "Couldn't create cache directory %s: %s", plug->cache_dir, strerror(errno));
+        plug->cache_dir[0] = '\0';
+    }
+
+    const char* mb = getenv(MODULE_CACHE_ENV);
+    plug->module_budget = plug->cache_dir[0] ? (mb ? strtoull(mb, NULL, 10) : MODULE_CACHE_DEFAULT_MB) << 20 : 0;
+}
+
+bool plug_cache_path(const char* name, char* o)
+{
+    if (!plug->cache_dir[0]) return false;
+    return snprintf(o, TEXT_CAP, "%s%c%s", plug->cache_dir, DELIM, name) < TEXT_CAP;
+}
+
+static int compare_cache_entries(const void* a, const void* b)
+{
+    const time_t x = ((const Cache_Entry*) a)->mtime, y = ((const Cache_Entry*) b)->mtime;
+    return (x > y) - (x < y);
+}
+
+// Files named `prefix` + 16 hex digits of key + `ext`, by mtime as their last use. Other files with
+// the key of `replacing` are older versions of it and go first, then the least recently used ones
+// until the rest fits in `budget`.
+Cache_Usage plug_cache_evict(const char* cache_dir, const char* prefix, const char* ext, const char* replacing, uint64_t budget)
+{
+    Cache_Usage usage = {0};
+    DIR* dir = opendir(cache_dir);
+    if (!dir) return usage;
+
+    const size_t prefix_len = strlen(prefix);
+    const size_t key_len = prefix_len + 16;
+
+    Cache_Entry* entries = NULL;
+    size_t count = 0, cap = 0;
+
+    char path[TEXT_CAP*2];
+    for (struct dirent* ent; (ent = readdir(dir));) {
+        const char* dot = strrchr(ent->d_name, '.');
+        if (strncmp(ent->d_name, prefix, prefix_len) != 0 || !dot || strcmp(dot, ext) != 0) continue;
+
+        snprintf(path, sizeof(path), "%s%c%s", cache_dir, DELIM, ent->d_name);
+        if (replacing && strcmp(ent->d_name, replacing) != 0 && strncmp(ent->d_name, replacing, key_len) == 0) {
+            unlink(path);
+            continue;
+        }
+
+        struct stat st;
+        if (strlen(ent->d_name) >= sizeof(entries->name) || stat(path, &st) < 0) continue;
+
+        if (count >= cap) {
+            cap = cap == 0 ? DA_INIT_CAP : cap*2;
+            entries = realloc(entries, cap*sizeof(*entries));
+            assert(entries != NULL && "Buy more RAM lol");
+        }
+        strcpy(entries[count].name, ent->d_name);
+        entries[count].mtime = st.st_mtime;
+        entries[count].size = st.st_size;
+        usage.size += st.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    qsort(entries, count, sizeof(*entries), compare_cache_entries);
+    size_t first = 0;
+    for (; first < count && usage.size > budget; ++first) {
+        snprintf(path, sizeof(path), "%s%c%s", cache_dir, DELIM, entries[first].name);
+        if (unlink(path) == 0) usage.size -= entries[first].size;
+    }
+
+    usage.count = count - first;
+    usage.oldest = first < count ? entries[first].mtime : 0;
+    free(entries);
+    return usage;
+}
+
+// Rendered modules are keyed by the content of the module, so renames and copies hit the cache
+bool plug_module_cache_lookup(const Song* song, char* o, uint64_t* hash)
+{
+    *hash = 0;
+
+#ifdef PRERENDER_MODULES
+    Music_Data data = {0};
+    if (!music_data_open(song->path, &data)) return false;
+    *hash = hash_bytes(data.data, data.size);
+    music_data_close(&data);
+
+    char name[64];
+    snprintf(name, sizeof(name), "module-%016llx.wav", (unsigned long long) *hash);
+    if (!plug_cache_path(name, o)) {
+        *hash = 0;
+        return false;
+    }
+
+    // Played now, eviction goes by mtime
+    return utimensat(AT_FDCWD, o, NULL, 0) == 0;
+#else
+    (void) song;
+    (void) o;
+    return false;
+#endif
+}
+
+#ifdef PRERENDER_MODULES
+static bool write_wav(const char* path, const short* samples, uint32_t frames, uint32_t rate, uint16_t channels)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+
+    const uint32_t data_size = frames*channels*sizeof(short);
+    const uint32_t byte_rate = rate*channels*sizeof(short);
+    const uint16_t block_align = channels*sizeof(short), bits = 16, pcm = 1;
+    const uint32_t riff_size = 36 + data_size, fmt_size = 16;
+
+    fwrite("RIFF", 1, 4, f); fwrite(&riff_size, 4, 1, f); fwrite("WAVE", 1, 4, f);
+    fwrite("fmt ", 1, 4, f); fwrite(&fmt_size, 4, 1, f);
+    fwrite(&pcm, 2, 1, f); fwrite(&channels, 2, 1, f);
+    fwrite(&rate, 4, 1, f); fwrite(&byte_rate, 4, 1, f);
+    fwrite(&block_align, 2, 1, f); fwrite(&bits, 2, 1, f);
+    fwrite("data", 1, 4, f); fwrite(&data_size, 4, 1, f);
+    fwrite(samples, sizeof(short), (size_t) frames*channels, f);
+
+    const bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+// Renders the whole module once, the same way UpdateMusicStream() would have in real time
+static void module_render_job_run(Job* job_)
+{
+    Module_Render_Job* job = (Module_Render_Job*) job_;
+    const double start = thread_cpu_time();
+
+    short* samples = NULL;
+    uint64_t frames = 0;
+
+    if (strcasecmp(strrchr(job->path, '.'), ".xm") == 0) {
+        int size = 0;
+        unsigned char* data = LoadFileData(job->path, &size);
+        jar_xm_context_t* ctx = NULL;
+        if (data && jar_xm_create_context_safe(&ctx, (const char*) data, size, MODULE_RENDER_RATE) == 0) {
+            jar_xm_set_max_loop_count(ctx, 1);
+            frames = jar_xm_get_remaining_samples(ctx);
+            samples = frames > 0 && frames < UINT32_MAX/2 ? malloc(frames*2*sizeof(short)) : NULL;
+            if (samples) jar_xm_generate_samples_16bit(ctx, samples, frames);
+            jar_xm_free_context(ctx);
+        }
+        UnloadFileData(data);
+    } else {
+        jar_mod_context_t ctx;
+        jar_mod_init(&ctx);
+        jar_mod_setcfg(&ctx, MODULE_RENDER_RATE, 16, 1, 1, 0);
+        if (jar_mod_load_file(&ctx, job->path) > 0) {
+            frames = jar_mod_max_samples(&ctx);
+            samples = frames > 0 && frames < UINT32_MAX/2 ? malloc(frames*2*sizeof(short)) : NULL;
+            if (samples) jar_mod_fillbuffer(&ctx, samples, frames, NULL);
+        }
+        jar_mod_unload(&ctx);
+    }
+
+    if (samples) {
+        // Written aside and renamed, so a half written render is never picked up
+        char tmp_path[TEXT_CAP + 8];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", job->out_path);
+        job->ok = write_wav(tmp_path, samples, frames, MODULE_RENDER_RATE, 2)
+               && rename(tmp_path, job->out_path) == 0;
+        if (!job->ok) unlink(tmp_path);
+        free(samples);
+    }
+    if (job->ok && job->budget > 0) plug_cache_evict(job->cache_dir, "module-", ".wav", NULL, job->budget);
+
+    job->duration = (float) frames / MODULE_RENDER_RATE;
+    job->elapsed = thread_cpu_time() - start;
+}
+
+static void module_render_job_done(Job* job_)
+{
+    Module_Render_Job* job = (Module_Render_Job*) job_;
+    if (plug->module_rendering == job->hash) plug->module_rendering = 0;
+
+    if (!job->job.cancelled && job->ok) {
+        TraceLog(LOG_INFO, "Rendered %s: %.1f seconds of audio in %.2f seconds", job->path, job->duration, job->elapsed);
+
+        // Still playing it live, move over to the rendered copy where we are now
+        const Song* curr_song = plug_get_curr_song();
+        if (curr_song && curr_song->id == job->song_id && plug->music_loaded && FileExists(job->out_path)) {
+            const float position = plug_music_time();
+            if (!plug_swap_music(job->out_path, position))
+                TraceLog(LOG_ERROR, "Couldn't load rendered module %s", job->out_path);
+        }
+    } else if (!job->job.cancelled) TraceLog(LOG_ERROR, "Couldn't render module %s", job->path);
+
+    free(job);
+}
+#endif
+
+void plug_module_render_submit(const Song* song, uint64_t hash, const char* out_path)
+{
+#ifdef PRERENDER_MODULES
+    if (plug->module_rendering == hash || plug->module_budget == 0 || plug->workers.count == 0) return;
+
+    Module_Render_Job* job = calloc(1, sizeof(*job));
+    assert(job != NULL && "Buy more RAM lol");
+    job->job.run = module_render_job_run;
+    job->job.done = module_render_job_done;
+    job->song_id = song->id;
+    job->hash = hash;
+    job->budget = plug->module_budget;
+    strcpy(job->path, song->path);
+    strcpy(job->out_path, out_path);
+    strcpy(job->cache_dir, plug->cache_dir);
+
+    plug->module_rendering = hash;
+    plug_workers_submit(&job->job);
+#else
+    (void) song;
+    (void) hash;
+    (void) out_path;
+#endif
+}
+
+static const char* ASSET_PATHS[ASSETS_CAP] = {
+    [ASSET_FONT] = FONT_PATH,
+    [ASSET_MUTED] = MUTED_PATH,
+    [ASSET_UNMUTED] = UNMUTED_PATH,
+    [ASSET_SHUFFLE] = SHUFFLE_PATH,
+    [ASSET_CROSSED_SHUFFLE] = CROSSED_SHUFFLE_PATH,
+};
+
+#define ALIGN16(x) (((x) + 15) & ~(size_t) 15)
+
+// Serves the images and glyphs straight out of the mapped blob, if it's still fresh
+static bool assets_blob_map(Assets_Job* job)
+{
+    const int fd = open(job->blob_path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    void* blob = fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(Assets_Blob_Header)
+        ? mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)
+        : MAP_FAILED;
+    close(fd);
+    if (blob == MAP_FAILED) return false;
+
+    const size_t size = st.st_size;
+    const Assets_Blob_Header* header = blob;
+    bool ok = memcmp(header->magic, ASSETS_BLOB_MAGIC, sizeof(header->magic)) == 0
+           && header->version == ASSETS_BLOB_VERSION
+           && header->font_size == job->font_size
+           && header->glyph_count > 0
+           && header->glyphs_offset + (size_t) header->glyph_count*sizeof(Assets_Blob_Glyph) <= size;
+
+    for (size_t i = 0; ok && i < ASSETS_CAP; ++i) {
+        ok = header->mtimes[i] == GetFileModTime(ASSET_PATHS[i])
+          && (size_t) header->images[i].offset + header->images[i].size <= size
+          && header->images[i].size == (uint32_t) GetPixelDataSize(header->images[i].width,
+                                                                   header->images[i].height,
+                                                                   header->images[i].format);
+    }
+
+    if (!ok) {
+        munmap(blob, size);
+        return false;
+    }
+
+    madvise(blob, size, MADV_WILLNEED);
+
+    for (size_t i = 0; i < ASSETS_CAP; ++i) {
+        job->images[i] = (Image) {
+            .data = (unsigned char*) blob + header->images[i].offset,
+            .width = header->images[i].width,
+            .height = header->images[i].height,
+            .mipmaps = 1,
+            .format = header->images[i].format,
+        };
+    }
+
+    job->glyph_count = header->glyph_count;
+    job->glyph_padding = header->glyph_padding;
+    job->glyphs = calloc(job->glyph_count, sizeof(*job->glyphs));
+    job->recs = calloc(job->glyph_count, sizeof(*job->recs));
+    assert(job->glyphs != NULL && job->recs != NULL && "Buy more RAM lol");
+
+    const Assets_Blob_Glyph* glyphs = (const Assets_Blob_Glyph*) ((const unsigned char*) blob + header->glyphs_offset);
+    for (int i = 0; i < job->glyph_count; ++i) {
+        job->glyphs[i] = (GlyphInfo) {
+            .value = glyphs[i].value,
+            .offsetX = glyphs[i].offset_x,
+            .offsetY = glyphs[i].offset_y,
+            .advanceX = glyphs[i].advance_x,
+        };
+        job->recs[i] = glyphs[i].rec;
+    }
+
+    job->blob = blob;
+    job->blob_size = size;
+    return true;
+}
+
+// Rasterizes the font and decodes the icons the slow way, the same as LoadFontEx() and LoadTexture() would
+static bool assets_decode(Assets_Job* job)
+{
+    int size = 0;
+    unsigned char* ttf = LoadFileData(ASSET_PATHS[ASSET_FONT], &size);
+    if (!ttf) return false;
+
+    job->glyph_count = ASSETS_GLYPH_COUNT;
+    job->glyph_padding = ASSETS_GLYPH_PADDING;
+    job->glyphs = LoadFontData(ttf, size, job->font_size, NULL, job->glyph_count, FONT_DEFAULT);
+    UnloadFileData(ttf);
+    if (!job->glyphs) return false;
+
+    job->images[ASSET_FONT] = GenImageFontAtlas(job->glyphs, &job->recs, job->glyph_count,
+                                                job->font_size, job->glyph_padding, 0);
+
+    // Everything the GPU needs is in the atlas now
+    for (int i = 0; i < job->glyph_count; ++i) {
+        UnloadImage(job->glyphs[i].image);
+        job->glyphs[i].image = (Image) {0};
+    }
+
+    // LoadImage() goes through IsFileExtension(), which isn't thread safe
+    for (size_t i = ASSET_FONT + 1; i < ASSETS_CAP; ++i) {
+        unsigned char* png = LoadFileData(ASSET_PATHS[i], &size);
+        if (png) job->images[i] = LoadImageFromMemory(".png", png, size);
+        UnloadFileData(png);
+    }
+
+    for (size_t i = 0; i < ASSETS_CAP; ++i)
+        if (!job->images[i].data) return false;
+
+    return true;
+}
+
+static void assets_blob_write(const Assets_Job* job)
+{
+    Assets_Blob_Header header = {0};
+    memcpy(header.magic, ASSETS_BLOB_MAGIC, sizeof(header.magic));
+    header.version = ASSETS_BLOB_VERSION;
+    header.font_size = job->font_size;
+    header.glyph_count = job->glyph_count;
+    header.glyph_padding = job->glyph_padding;
+
+    size_t offset = ALIGN16(sizeof(header));
+    for (size_t i = 0; i < ASSETS_CAP; ++i) {
+        const Image* image = &job->images[i];
+        header.mtimes[i] = GetFileModTime(ASSET_PATHS[i]);
+        header.images[i].width = image->width;
+        header.images[i].height = image->height;
+        header.images[i].format = image->format;
+        header.images[i].offset = offset;
+        header.images[i].size = GetPixelDataSize(image->width, image->height, image->format);
+        offset = ALIGN16(offset + header.images[i].size);
+    }
+    header.glyphs_offset = offset;
+
+    char tmp_path[TEXT_CAP + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", job->blob_path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) return;
+
+    static const unsigned char zeros[16] = {0};
+    fwrite(&header, sizeof(header), 1, f);
+    fwrite(zeros, 1, ALIGN16(sizeof(header)) - sizeof(header), f);
+    for (size_t i = 0; i < ASSETS_CAP; ++i) {
+        fwrite(job->images[i].data, 1, header.images[i].size, f);
+        fwrite(zeros, 1, ALIGN16(header.images[i].size) - header.images[i].size, f);
+    }
+    for (int i = 0; i < job->glyph_count; ++i) {
+        const Assets_Blob_Glyph glyph = {
+            .value = job->glyphs[i].value,
+            .offset_x = job->glyphs[i].offsetX,
+            .offset_y = job->glyphs[i].offsetY,
+            .advance_x = job->glyphs[i].advanceX,
+            .rec = job->recs[i],
+        };
+        fwrite(&glyph, sizeof(glyph), 1, f);
+    }
+
+    const bool ok = !ferror(f);
+    if (fclose(f) == 0 && ok && rename(tmp_path, job->blob_path) == 0)
+        TraceLog(LOG_INFO, "ASSETS: baked into %s", job->blob_path);
+    else unlink(tmp_path);
+}
+
+static void assets_job_run(Job* job_)
+{
+    Assets_Job* job = (Assets_Job*) job_;
+    const double start = monotonic_time();
+
+    job->ok = (job->blob_path[0] && assets_blob_map(job)) || assets_decode(job);
+    if (job->ok && !job->blob && job->blob_path[0]) assets_blob_write(job);
+
+    job->elapsed = monotonic_time() - start;
+}
+
+static void assets_job_free(Assets_Job* job)
+{
+    if (job->blob) munmap(job->blob, job->blob_size);
+    else for (size_t i = 0; i < ASSETS_CAP; ++i) UnloadImage(job->images[i]);
+    free(job->glyphs);
+    free(job->recs);
+    free(job);
+}
+
+// Only the GPU upload is left for the main thread
+static void assets_job_done(Job* job_)
+{
+    Assets_Job* job = (Assets_Job*) job_;
+    plug->assets_loading = false;
+
+    if (job->job.cancelled || !job->ok) {
+        if (!job->job.cancelled) TraceLog(LOG_ERROR, "ASSETS: couldn't load the font and icons");
+        assets_job_free(job);
+        return;
+    }
+
+    plug->font = (Font) {
+        .baseSize = job->font_size,
+        .glyphCount = job->glyph_count,
+        .glyphPadding = job->glyph_padding,
+        .texture = LoadTextureFromImage(job->images[ASSET_FONT]),
+        .recs = job->recs,
+        .glyphs = job->glyphs,
+    };
+    job->recs = NULL;
+    job->glyphs = NULL;
+    plug->font_loaded = true;
+    GenTextureMipmaps(&plug->font.texture);
+    SetTextureFilter(plug->font.texture, TEXTURE_FILTER_BILINEAR);
+
+#define UPLOAD_TEXTURE(name, asset)                                      \
+    if (!plug->name##_texture_loaded) {                                  \
+        plug->name##_t.texture = LoadTextureFromImage(job->images[asset]); \
+        plug->name##_texture_loaded = true;                              \
+    }
+    UPLOAD_TEXTURE(muted, ASSET_MUTED);
+    UPLOAD_TEXTURE(unmuted, ASSET_UNMUTED);
+    UPLOAD_TEXTURE(shuffle, ASSET_SHUFFLE);
+    UPLOAD_TEXTURE(crossed_shuffle, ASSET_CROSSED_SHUFFLE);
+#undef UPLOAD_TEXTURE
+
+    // Labels were measured with the default font until now
+    plug->song_name.text_size = MeasureTextEx(plug->font, plug->song_name.text, plug->font_size, plug->font_spacing);
+    plug->song_time.text_size = MeasureTextEx(plug->font, plug->song_time.text, plug->font_size, plug->font_spacing);
+    plug_init_text_labels(false);
+    plug_init_constant_text_labels();
+
+    TraceLog(LOG_INFO, "ASSETS: %s in %.3f seconds", job->blob ? "mapped baked blob" : "decoded sources", job->elapsed);
+    assets_job_free(job);
+}
+
+// Decoding and disk I/O happen on the pool while the first frames are drawn with the default font
+void plug_load_assets(void)
+{
+    if (plug->assets_loading || plug->font_loaded) return;
+
+    Assets_Job* job = calloc(1, sizeof(*job));
+    assert(job != NULL && "Buy more RAM lol");
+    job->job.run = assets_job_run;
+    job->job.done = assets_job_done;
+    job->font_size = plug->font_size;
+    if (!plug_cache_path(ASSETS_BLOB_NAME, job->blob_path)) job->blob_path[0] = '\0';
+
+    plug->assets_loading = true;
+    if (plug->workers.count > 0) plug_workers_submit(&job->job);
+    else {
+        job->job.run(&job->job);
+        job->job.done(&job->job);
+    }
+}
+
+// The first PREFLIGHT_DECODE_FRAMES of the file, decoded the way it will be played
+#ifdef STREAM_DECODE
+static const char* preflight_decode(const char* path, const char* ext, const unsigned char* probe, size_t n)
+{
+    (void) probe;
+    (void) n;
+
+    short* samples = malloc(PREFLIGHT_DECODE_FRAMES*DECODER_MAX_CHANNELS*sizeof(*samples));
+    assert(samples != NULL && "Buy more RAM lol");
+    bool ok = false;
+
+    if (strcmp(ext, ".xm") == 0 || strcmp(ext, ".mod") == 0) {
+#ifdef PRERENDER_MODULES
+        if (strcmp(ext, ".xm") == 0) {
+            int size = 0;
+            unsigned char* data = LoadFileData(path, &size);
+            jar_xm_context_t* ctx = NULL;
+            if (data && jar_xm_create_context_safe(&ctx, (const char*) data, size, MODULE_RENDER_RATE) == 0) {
+                ok = jar_xm_get_remaining_samples(ctx) > 0;
+                if (ok) jar_xm_generate_samples_16bit(ctx, samples, PREFLIGHT_DECODE_FRAMES);
+                jar_xm_free_context(ctx);
+            }
+            UnloadFileData(data);
+        } else {
+            jar_mod_context_t ctx;
+            jar_mod_init(&ctx);
+            jar_mod_setcfg(&ctx, MODULE_RENDER_RATE, 16, 1, 1, 0);
+            ok = jar_mod_load_file(&ctx, path) > 0 && jar_mod_max_samples(&ctx) > 0;
+            if (ok) jar_mod_fillbuffer(&ctx, samples, PREFLIGHT_DECODE_FRAMES, NULL);
+            jar_mod_unload(&ctx);
+        }
+#else
+        ok = true; // Only the header checks without raylib's renderers
+#endif
+    } else {
+        Decoder* dec = decoder_open(path);
+        ok = dec && decoder_read(dec, samples, PREFLIGHT_DECODE_FRAMES) > 0;
+        if (dec) decoder_close(dec);
+    }
+
+    free(samples);
+    return ok ? NULL : "first frames don't decode";
+}
+#else
+// Without raylib's decoders only the probe is decoded, oggs and modules get their header checked
+static const char* preflight_decode(const char* path, const char* ext, const unsigned char* probe, size_t n)
+{
+    (void) path;
+    if (strcmp(ext, ".ogg") == 0 || strcmp(ext, ".xm") == 0 || strcmp(ext, ".mod") == 0) return NULL;
+
+    Wave wave = LoadWaveFromMemory(ext, probe, n);
+    const char* reason = wave.frameCount == 0 || wave.data == NULL ? "first frames don't decode" : NULL;
+    UnloadWave(wave);
+    return reason;
+}
+#endif
+
+// Cheap checks that catch what would otherwise only show up when the song is switched to:
+// the file is there, its header looks like what its extension says, and its first frames decode.
+// Returns NULL if the song looks playable, a reason otherwise.
+const char* preflight_check(const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return "missing";
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return "not a regular file or empty";
+    }
+
+    char ext[8] = {0};
+    const char* dot = strrchr(path, '.');
+    for (size_t i = 0; dot && dot[i] && i < sizeof(ext) - 1; ++i)
+        ext[i] = (dot[i] >= 'A' && dot[i] <= 'Z') ? dot[i] - 'A' + 'a' : dot[i];
+
+    // An mp3's audio starts after its ID3v2 tag, which can be megabytes of cover art
+    size_t offset = 0;
+    if (strcmp(ext, ".mp3") == 0) {
+        unsigned char tag[10];
+        if (pread(fd, tag, sizeof(tag), 0) == sizeof(tag)) offset = id3v2_size(tag, sizeof(tag));
+        if (offset >= (size_t) st.st_size) {
+            close(fd);
+            return "truncated";
+        }
+    }
+
+    const size_t probe_size = MIN((size_t) st.st_size - offset, PREFLIGHT_PROBE_BYTES);
+    unsigned char* probe = malloc(probe_size);
+    assert(probe != NULL && "Buy more RAM lol");
+
+    size_t n = 0;
+    for (ssize_t r; n < probe_size && (r = pread(fd, probe + n, probe_size - n, offset + n)) > 0;) n += r;
+    close(fd);
+
+    const char* reason = NULL;
+
+    if (n < 16) reason = "truncated";
+    else if (strcmp(ext, ".wav") == 0) {
+        if ((memcmp(probe, "RIFF", 4) != 0 && memcmp(probe, "RF64", 4) != 0) || memcmp(probe + 8, "WAVE", 4) != 0)
+            reason = "bad wav header";
+    } else if (strcmp(ext, ".ogg") == 0) {
+        // The identification header comes right after the first page's header
+        if (n < 35 || memcmp(probe, "OggS", 4) != 0 || memcmp(probe + 28, "\x01vorbis", 7) != 0)
+            reason = "bad ogg header";
+    } else if (strcmp(ext, ".mp3") == 0) {
+        // Some have padding or junk before the first frame, the decoder syncs past it
+        bool sync = false;
+        for (size_t i = 0; i + 1 < n && !sync; ++i) sync = probe[i] == 0xFF && (probe[i + 1] & 0xE0) == 0xE0;
+        if (!sync) reason = "bad mp3 header";
+    } else if (strcmp(ext, ".qoa") == 0) {
+        if (memcmp(probe, "qoaf", 4) != 0) reason = "bad qoa header";
+    } else if (strcmp(ext, ".xm") == 0) {
+        if (n < 60 || memcmp(probe, "Extended Module: ", 17) != 0) reason = "bad xm header";
+    } else if (strcmp(ext, ".mod") == 0) {
+        // Order table and tag come after the 31 sample headers
+        if (n < 1084) reason = "truncated mod";
+    } else reason = "unsupported format";
+
+    if (!reason) reason = preflight_decode(path, ext, probe, n);
+
+    free(probe);
+    return reason;
+}
+
+// Songs that were skipped as duplicates of this one are the copies to play now
+void plug_mark_song_bad(Song* song)
+{
+    song->check_state = CHECK_BAD;
+    for (size_t i = 0; i < plug->pl.count; ++i)
+        if (plug->pl.songs[i].duplicate_of == song->id)
+            plug->pl.songs[i].duplicate_of = 0;
+}
+
+static void preflight_job_run(Job* job_)
+{
+    Preflight_Job* job = (Preflight_Job*) job_;
+    job->reason = preflight_check(job->path);
+    job->ok = job->reason == NULL;
+}
+
+static void preflight_job_done(Job* job_)
+{
+    Preflight_Job* job = (Preflight_Job*) job_;
+    Song* song = plug_find_song(job->song_id, job->song_hint);
+
+    if (song && song->check_state == CHECK_PENDING) {
+        if (job->job.cancelled) song->check_state = CHECK_NONE;
+        else if (job->ok) song->check_state = CHECK_OK;
+        else {
+            plug_mark_song_bad(song);
+            TraceLog(LOG_WARNING, "PREFLIGHT: skipping %s: %s", song->path, job->reason);
+        }
+    }
+
+    free(job);
+}
+
+static void plug_preflight_submit(size_t index)
+{
+    Song* song = &plug->pl.songs[index];
+    if (song->check_state != CHECK_NONE) return;
+
+    Preflight_Job* job = calloc(1, sizeof(*job));
+    assert(job != NULL && "Buy more RAM lol");
+    job->job.run = preflight_job_run;
+    job->job.done = preflight_job_done;
+    job->song_id = song->id;
+    job->song_hint = index;
+    strcpy(job->path, song->path);
+
+    song->check_state = CHECK_PENDING;
+    plug_workers_submit_front(&job->job);
+}
+
+// Validates the next PREFLIGHT_AHEAD songs in play order, so switching never has to stall on a bad one
+void plug_preflight_schedule(void)
+{
+    Playlist* pl = &plug->pl;
+    if (pl->count < 2 || plug->workers.count == 0) return;
+
+    if (plug->shuffle_mode) {
+        while (pl->upcoming_count < PREFLIGHT_AHEAD) {
+            size_t pick = PL_RAND(pl->count);
+            for (size_t tries = 0; tries < pl->count && (pick == pl->curr || is_song_skipped(&pl->songs[pick])); ++tries)
+                pick = PL_RAND(pl->count);
+            pl->upcoming[pl->upcoming_count++] = pick;
+        }
+
+        for (size_t i = 0; i < pl->upcoming_count; ++i)
+            if (pl->upcoming[i] < pl->count) plug_preflight_submit(pl->upcoming[i]);
+        return;
+    }
+
+    size_t index = pl->curr, ahead = 0;
+    for (size_t i = 0; i < pl->count && ahead < PREFLIGHT_AHEAD; ++i) {
+        index = index + 1 >= pl->count ? 0 : index + 1;
+        if (index == pl->curr) break;
+        if (is_song_skipped(&pl->songs[index])) continue;
+
+        plug_preflight_submit(index);
+        ahead++;
+    }
+}
+
+// Speed is SetMusicPitch() resampling, which also raises the pitch, undone by the time stretch.
+// The decoder still counts source frames, so GetMusicTimePlayed() and seeking stay in source time.
+void plug_set_music_speed(float speed)
+{
+    plug->music_speed = MIN(MAX(speed, MIN_MUSIC_SPEED), MAX_MUSIC_SPEED);
+    atomic_store(&plug->stretch.ratio, 1.f / plug->music_speed);
+    if (plug->music_loaded) SetMusicPitch(plug->curr_music, plug->music_speed);
+    TraceLog(LOG_INFO, "Playback speed: x%.2f", plug->music_speed);
+}
+
+// Attached at any speed, so a speed change never starts it over from an empty ring
+void plug_attach_music(Music m)
+{
+    // Streams get no buffer without an audio device, like under the benchmarks
+    if (m.stream.buffer == NULL) return;
+
+    SetMusicPitch(m, plug->music_speed);
+    if (m.stream.channels == 0 || m.stream.channels > STRETCH_MAX_CHANNELS) {
+        TraceLog(LOG_WARNING, "STRETCH: %u channels, speed changes will shift the pitch", m.stream.channels);
+        return;
+    }
+
+    atomic_store(&plug->stretch.ratio, 1.f / plug->music_speed);
+    time_stretch_reset(&plug->stretch, m.stream.channels);
+    AttachAudioStreamProcessor(m.stream, time_stretch_processor);
+    plug->stretch_attached = true;
+}
+
+void plug_detach_music(Music m)
+{
+    if (plug->stretch_attached && m.stream.buffer != NULL) DetachAudioStreamProcessor(m.stream, time_stretch_processor);
+    plug->stretch_attached = false;
+}
+
+// For the start of a stream, away from x1 the reader starts its delay behind
+void time_stretch_reset(Time_Stretch* ts, size_t channels)
+{
+    memset(ts->ring, 0, sizeof(ts->ring));
+    ts->written = 0;
+    ts->channels = channels;
+    ts->active = atomic_load(&ts->ratio) != 1.f;
+    ts->read = -STRETCH_START_DELAY;
+    ts->xfade_left = 0;
+    ts->xfade_dry = false;
+}
+
+static float dot_product(const float* a, const float* b, size_t n)
+{
+    float sum = 0.f;
+    size_t i = 0;
+#if defined(__SSE__)
+    __m128 acc = _mm_setzero_ps();
+    for (; i < (n & ~(size_t) 3); i += 4) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < n; ++i) sum += a[i]*b[i];
+    return sum;
+}
+
+static inline float stretch_sample(const Time_Stretch* ts, int64_t frame, size_t channel)
+{
+    if (frame < MAX(ts->written - STRETCH_RING_CAP, 0) || frame >= ts->written) return 0.f;
+    return ts->ring[(frame & (STRETCH_RING_CAP - 1))*STRETCH_MAX_CHANNELS + channel];
+}
+
+static inline float stretch_mono(const Time_Stretch* ts, int64_t frame)
+{
+    float sum = 0.f;
+    for (size_t c = 0; c < ts->channels; ++c) sum += stretch_sample(ts, frame, c);
+    return sum;
+}
+
+static inline float stretch_read(const Time_Stretch* ts, double pos, size_t channel)
+{
+    const int64_t i = (int64_t) floor(pos);
+    const float t = pos - i;
+    return stretch_sample(ts, i, channel)*(1.f - t) + stretch_sample(ts, i + 1, channel)*t;
+}
+
+// Picks where to splice to: the spot around `nominal` whose upcoming audio lines up best
+// with what the reader is about to play, by normalized cross-correlation of the mono mix
+static double stretch_find_splice(Time_Stretch* ts, double nominal)
+{
+    const int64_t from = (int64_t) ts->read;
+    const int64_t base = (int64_t) nominal - STRETCH_SEARCH;
+
+    for (size_t i = 0; i < STRETCH_XFADE; ++i) ts->ref[i] = stretch_mono(ts, from + i);
+    for (size_t i = 0; i < 2*STRETCH_SEARCH + STRETCH_XFADE; ++i) ts->candidates[i] = stretch_mono(ts, base + i);
+
+    float energy = dot_product(ts->candidates, ts->candidates, STRETCH_XFADE);
+    float best = -INFINITY;
+    size_t best_offset = STRETCH_SEARCH;
+
+    for (size_t k = 0; k <= 2*STRETCH_SEARCH; ++k) {
+        const float score = dot_product(ts->ref, ts->candidates + k, STRETCH_XFADE) / sqrtf(energy + 1e-9f);
+        if (score > best) {
+            best = score;
+            best_offset = k;
+        }
+
+        if (k < 2*STRETCH_SEARCH) {
+            const float out = ts->candidates[k], in = ts->candidates[k + STRETCH_XFADE];
+            energy = MAX(energy - out*out + in*in, 0.f);
+        }
+    }
+
+    return (double) (base + (int64_t) best_offset) + (ts->read - from);
+}
+
+// First speed change: crossfades from the dry frames to the spot about STRETCH_START_DELAY back
+// (less right after the stream started) whose audio lines up best with the last crossfade worth
+// of them, so it picks up where they end
+static void stretch_activate(Time_Stretch* ts)
+{
+    ts->read = ts->written - STRETCH_XFADE;
+    ts->xfade = stretch_find_splice(ts, MAX(ts->read - STRETCH_START_DELAY, STRETCH_SEARCH)) + STRETCH_XFADE - 1;
+    ts->xfade_left = STRETCH_XFADE;
+    ts->xfade_dry = true;
+    ts->active = true;
+}
+
+void time_stretch_process(Time_Stretch* ts, float* frames, size_t count)
+{
+    const float ratio = atomic_load(&ts->ratio);
+    const size_t channels = ts->channels;
+
+    for (size_t i = 0; i < count; ++i) {
+        float* frame = &frames[i*channels];
+        memcpy(&ts->ring[(ts->written & (STRETCH_RING_CAP - 1))*STRETCH_MAX_CHANNELS], frame, channels*sizeof(*frame));
+        ts->written++;
+
+        const double delay = ts->written - ts->read;
+        if (ts->xfade_left == 0) {
+            if (!ts->active) {
+                if (ratio == 1.f) continue;
+                stretch_activate(ts);
+            } else if (delay > STRETCH_MAX_DELAY) {
+                ts->xfade = stretch_find_splice(ts, ts->read + STRETCH_JUMP);
+                ts->xfade_left = STRETCH_XFADE;
+            } else if (delay < STRETCH_MIN_DELAY && ratio > 1.f) {
+                ts->xfade = stretch_find_splice(ts, ts->read - STRETCH_JUMP);
+                ts->xfade_left = STRETCH_XFADE;
+            }
+        }
+
+        for (size_t c = 0; c < channels; ++c) {
+            if (!ts->xfade_dry) frame[c] = stretch_read(ts, ts->read, c);
+            if (ts->xfade_left > 0) {
+                const float t = 1.f - (float) ts->xfade_left / STRETCH_XFADE;
+                frame[c] = frame[c]*(1.f - t) + stretch_read(ts, ts->xfade, c)*t;
+            }
+        }
+
+        ts->read += ratio;
+        if (ts->xfade_left > 0) {
+            ts->xfade += ratio;
+            if (--ts->xfade_left == 0) {
+                ts->read = ts->xfade;
+                ts->xfade_dry = false;
+            }
+        }
+    }
+}
+
+// raylib hands processors the already resampled frames, in the stream's channels
+void time_stretch_processor(void* buffer, unsigned int frames)
+{
+    if (plug) time_stretch_process(&plug->stretch, buffer, frames);
+}
+
+// Without an audio device streams never start, so the player keeps the playback clock itself
+// from the frame times. That's what a headless replay runs against.
+bool plug_music_playing(void)
+{
+    if (plug->null_sink) return plug->music_loaded && !plug->music_paused;
+    return IsMusicStreamPlaying(plug->curr_music);
+}
+
+float plug_music_time(void)
+{
+    return plug->null_sink ? plug->null_sink_time : GetMusicTimePlayed(plug->curr_music);
+}
+
+void plug_music_seek(float position)
+{
+    SeekMusicStream(plug->curr_music, position);
+    plug->null_sink_time = position;
+}
+
+static void input_record_frame(const Input* in)
+{
+    const double t = in->time - in->record_start;
+
+    if (in->key) fprintf(in->record, "%zu %.6f key %d\n", in->frame, t, in->key);
+    if (in->clicked) fprintf(in->record, "%zu %.6f click %.1f %.1f\n", in->frame, t, in->mouse.x, in->mouse.y);
+    if (in->resized) fprintf(in->record, "%zu %.6f resize %d %d\n", in->frame, t, GetScreenWidth(), GetScreenHeight());
+    for (size_t i = 0; i < in->dropped.count; ++i)
+        fprintf(in->record, "%zu %.6f drop %s\n", in->frame, t, in->dropped.paths[i]);
+}
+
+// Frames between events are spread evenly over the time between them
+static void input_replay_frame(Input* in)
+{
+    const Input_Event* prev = in->next_event > 0 ? &in->events[in->next_event - 1] : NULL;
+    const Input_Event* next = in->next_event < in->events_count ? &in->events[in->next_event] : NULL;
+
+    if (!next) in->time = prev ? prev->time : 0.;
+    else if (!prev || next->frame == prev->frame) in->time = next->time;
+    else in->time = prev->time + (double) (in->frame - prev->frame)/(next->frame - prev->frame)*(next->time - prev->time);
+
+    for (; in->next_event < in->events_count && in->events[in->next_event].frame <= in->frame; ++in->next_event) {
+        const Input_Event* ev = &in->events[in->next_event];
+        in->time = ev->time;
+
+        switch (ev->type) {
+        case INPUT_KEY: in->key = ev->key; break;
+
+        case INPUT_CLICK:
+            in->clicked = true;
+            in->mouse = ev->mouse;
+            break;
+
+        case INPUT_RESIZE:
+            SetWindowSize(ev->width, ev->height);
+            in->resized = true;
+            break;
+
+        case INPUT_DROP:
+            if (in->dropped.count >= in->drop_paths_cap) {
+                in->drop_paths_cap = in->drop_paths_cap == 0 ? DA_INIT_CAP : in->drop_paths_cap*2;
+                in->drop_paths = realloc(in->drop_paths, in->drop_paths_cap*sizeof(*in->drop_paths));
+                assert(in->drop_paths != NULL && "Buy more RAM lol");
+            }
+            in->drop_paths[in->dropped.count++] = ev->path;
+            in->dropped.paths = in->drop_paths;
+            break;
+
+        case INPUT_END: break;
+        }
+    }
+}
+
+// Everything the handlers read about input goes through here once per frame
+void plug_input_poll(void)
+{
+    Input* in = &plug->input;
+    const double prev_time = in->time;
+
+    if (!in->replaying && in->dropped.count > 0) UnloadDroppedFiles(in->dropped);
+    in->dropped = (FilePathList) {0};
+    in->key = 0;
+    in->clicked = false;
+    in->resized = false;
+
+    if (in->replaying) input_replay_frame(in);
+    else {
+        in->time = GetTime();
+        in->key = GetKeyPressed();
+        in->clicked = IsMouseButtonPressed(MOUSE_LEFT_BUTTON);
+        in->mouse = GetMousePosition();
+        in->resized = IsWindowResized();
+        if (IsFileDropped()) in->dropped = LoadDroppedFiles();
+        if (in->record) input_record_frame(in);
+    }
+
+    in->dt = in->frame > 0 ? in->time - prev_time : 0.;
+    in->frame++;
+}
+
+bool plug_input_record(const char* path, unsigned int seed)
+{
+    Input* in = &plug->input;
+
+    in->record = fopen(path, "w");
+    if (!in->record) {
+        TraceLog(LOG_ERROR, "INPUT: could not record to %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(in->record, "%s\nseed %u\nsize %d %d\n", INPUT_LOG_MAGIC, seed, GetScreenWidth(), GetScreenHeight());
+    in->record_start = GetTime();
+    TraceLog(LOG_INFO, "INPUT: recording to %s", path);
+    return true;
+}
+
+static void input_push_event(Input* in, Input_Event ev)
+{
+    if (in->events_count >= in->events_cap) {
+        in->events_cap = in->events_cap == 0 ? DA_INIT_CAP : in->events_cap*2;
+        in->events = realloc(in->events, in->events_cap*sizeof(*in->events));
+        assert(in->events != NULL && "Buy more RAM lol");
+    }
+    in->events[in->events_count++] = ev;
+}
+
+// Lines are `<frame> <seconds> <event> [args]`, after a header with the seed and the window size
+bool plug_input_replay(const char* path)
+{
+    Input* in = &plug->input;
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        TraceLog(LOG_ERROR, "INPUT: could not open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    char line[TEXT_CAP + 64];
+    unsigned int seed = 0;
+    int width = 0, height = 0;
+    if (!fgets(line, sizeof(line), f) || strncmp(line, INPUT_LOG_MAGIC, strlen(INPUT_LOG_MAGIC)) != 0
+    ||  fscanf(f, "seed %u\nsize %d %d\n", &seed, &width, &height) != 3) {
+        TraceLog(LOG_ERROR, "INPUT: %s is not an input log", path);
+        fclose(f);
+        return false;
+    }
+
+    // Starts at the recorded window size
+    input_push_event(in, (Input_Event) { .type = INPUT_RESIZE, .width = width, .height = height });
+
+    for (size_t lineno = 4; fgets(line, sizeof(line), f); ++lineno) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        Input_Event ev = {0};
+        char type[16];
+        int args = 0;
+        if (sscanf(line, "%zu %lf %15s %n", &ev.frame, &ev.time, type, &args) < 3) continue;
+        const char* rest = line + args;
+
+        bool ok = true;
+        if (strcmp(type, "key") == 0) {
+            ev.type = INPUT_KEY;
+            ok = sscanf(rest, "%d", &ev.key) == 1;
+        } else if (strcmp(type, "click") == 0) {
+            ev.type = INPUT_CLICK;
+            ok = sscanf(rest, "%f %f", &ev.mouse.x, &ev.mouse.y) == 2;
+        } else if (strcmp(type, "resize") == 0) {
+            ev.type = INPUT_RESIZE;
+            ok = sscanf(rest, "%d %d", &ev.width, &ev.height) == 2;
+        } else if (strcmp(type, "drop") == 0) {
+            ev.type = INPUT_DROP;
+            ev.path = strdup(rest);
+        } else if (strcmp(type, "end") == 0) ev.type = INPUT_END;
+        else ok = false;
+
+        if (ok) input_push_event(in, ev);
+        else TraceLog(LOG_WARNING, "INPUT: %s:%zu: skipping `%s`", path, lineno, line);
+    }
+    fclose(f);
+
+    srand(seed);
+    in->replaying = true;
+    TraceLog(LOG_INFO, "INPUT: replaying %zu events from %s", in->events_count, path);
+    return true;
+}
+
+bool plug_input_replay_done(void)
+{
+    const Input* in = &plug->input;
+    return !in->replaying || in->next_event >= in->events_count;
+}
+
+void plug_input_close(void)
+{
+    Input* in = &plug->input;
+
+    if (in->record) {
+        fprintf(in->record, "%zu %.6f end\n", in->frame > 0 ? in->frame - 1 : 0, GetTime() - in->record_start);
+        fclose(in->record);
+        in->record = NULL;
+    }
+
+    if (!in->replaying && in->dropped.count > 0) UnloadDroppedFiles(in->dropped);
+    in->dropped = (FilePathList) {0};
+
+    for (size_t i = 0; i < in->events_count; ++i) free(in->events[i].path);
+    free(in->events);
+    free(in->drop_paths);
+    in->events = NULL;
+    in->drop_paths = NULL;
+    in->events_count = in->events_cap = in->drop_paths_cap = in->next_event = 0;
+    in->replaying = false;
+}
+
+// Opt-in, PLAYER_QOA_CACHE_MB is how much the transcoded copies may take up
+void plug_init_transcode_budget(void)
+{
+    const char* mb = getenv(TRANSCODE_ENV);
+    plug->transcode_budget = mb && plug->cache_dir[0] ? strtoull(mb, NULL, 10) << 20 : 0;
+
+#ifndef TRANSCODE_QOA
+    if (plug->transcode_budget > 0) {
+        TraceLog(LOG_WARNING, "TRANSCODE: no QOA encoder without raylib's sources, see RAYLIB_SRC");
+        plug->transcode_budget = 0;
+    }
+#endif
+
+    if (plug->transcode_budget > 0)
+        TraceLog(LOG_INFO, "TRANSCODE: caching QOA copies in %s, up to %llu MB",
+                 plug->cache_dir, (unsigned long long) plug->transcode_budget >> 20);
+}
+
+bool is_transcodable(const char* path)
+{
+    const char* ext = strrchr(path, '.');
+    return ext && (strcasecmp(ext, ".mp3") == 0 || strcasecmp(ext, ".ogg") == 0);
+}
+
+// Keyed by path and mtime, an edited file gets a new copy and the old one ages out
+bool plug_transcode_cache_path(const char* path, char* o)
+{
+    struct stat st;
+    if (stat(path, &st) < 0) return false;
+
+    char name[64];
+    snprintf(name, sizeof(name), "qoa-%016llx-%llx-%llx.qoa",
+             (unsigned long long) hash_bytes((const unsigned char*) path, strlen(path)),
+             (unsigned long long) st.st_mtime, (unsigned long long) st.st_size);
+    return plug_cache_path(name, o);
+}
+
+bool plug_transcode_lookup(const char* path, char* o)
+{
+    if (plug->transcode_budget == 0 || !is_transcodable(path)) return false;
+    if (!plug_transcode_cache_path(path, o) || !FileExists(o)) return false;
+
+    // Played copies are the last to go when over budget
+    utimensat(AT_FDCWD, o, NULL, 0);
+    return true;
+}
+
+#ifdef TRANSCODE_QOA
+// Decoded and encoded a QOA frame at a time, so a long track never sits in memory decoded
+bool transcode_to_qoa(const char* path, const char* out_path, float* duration)
+{
+    Decoder* dec = decoder_open(path);
+    if (!dec) return false;
+
+    // The header wants the length up front, fixed up at the end if the decoder's was off
+    qoa_desc desc = {
+        .channels = dec->channels,
+        .samplerate = dec->sample_rate,
+        .samples = MIN(decoder_frame_count(dec), UINT32_MAX),
+    };
+    // What qoa_encode() starts every channel's predictor with
+    for (size_t c = 0; c < desc.channels; ++c)
+        desc.lms[c] = (qoa_lms_t) { .weights = {0, 0, -(1 << 13), 1 << 14} };
+
+    short* samples = malloc(QOA_FRAME_LEN*desc.channels*sizeof(*samples));
+    unsigned char* frame = malloc(qoa_max_frame_size(&desc));
+    assert(samples != NULL && frame != NULL && "Buy more RAM lol");
+
+    // Written aside and renamed, so a half written copy is never picked up
+    char tmp_path[TEXT_CAP + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", out_path);
+
+    unsigned char header[8];
+    const unsigned int header_size = qoa_encode_header(&desc, header);
+    FILE* f = fopen(tmp_path, "wb");
+    bool ok = f && fwrite(header, 1, header_size, f) == header_size;
+
+    uint64_t frames = 0;
+    for (size_t n; ok && (n = decoder_read(dec, samples, QOA_FRAME_LEN)) > 0; frames += n) {
+        const unsigned int size = qoa_encode_frame(samples, &desc, n, frame);
+        ok = fwrite(frame, 1, size, f) == size;
+    }
+    ok = ok && frames > 0 && frames <= UINT32_MAX;
+
+    if (ok && frames != desc.samples) {
+        desc.samples = frames;
+        qoa_encode_header(&desc, header);
+        ok = fseek(f, 0, SEEK_SET) == 0 && fwrite(header, 1, header_size, f) == header_size;
+    }
+
+    if (f) ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp_path, out_path) == 0;
+    if (!ok) unlink(tmp_path);
+
+    if (ok && duration) *duration = (float) frames / desc.samplerate;
+    free(samples);
+    free(frame);
+    decoder_close(dec);
+    return ok;
+}
+
+// Drops older copies of the same track, then the least recently played ones until under budget,
+// the new copy included when it's the least recently played. Without a new copy it only tallies.
+static void transcode_cache_evict(Transcode_Job* job)
+{
+    const char* out_name = job->path[0] ? strrchr(job->out_path, DELIM) + 1 : NULL;
+    job->cache = plug_cache_evict(job->cache_dir, "qoa-", ".qoa", out_name, job->budget);
+}
+
+static void transcode_job_run(Job* job_)
+{
+    Transcode_Job* job = (Transcode_Job*) job_;
+    const double start = thread_cpu_time();
+
+    if (job->path[0]) {
+        job->ok = transcode_to_qoa(job->path, job->out_path, &job->duration);
+        if (job->ok) {
+            const struct timespec times[2] = { { .tv_sec = job->recency }, { .tv_sec = job->recency } };
+            utimensat(AT_FDCWD, job->out_path, times, 0);
+        }
+    }
+    if (job->ok || !job->path[0]) transcode_cache_evict(job);
+
+    job->elapsed = thread_cpu_time() - start;
+}
+
+static void transcode_job_done(Job* job_)
+{
+    Transcode_Job* job = (Transcode_Job*) job_;
+    plug->transcoding = false;
+
+    if (!job->job.cancelled && (job->ok || !job->path[0])) {
+        // Room for another copy of the average size, otherwise a new one has to have been used
+        // more recently than the least recently played one, which it would take the place of
+        const uint64_t average = job->cache.count ? job->cache.size / job->cache.count : 0;
+        plug->transcode_floor = job->cache.size + average > job->budget ? job->cache.oldest : -1;
+        plug->transcode_scanned = true;
+        plug->transcode_recheck = true;
+    }
+
+    if (!job->path[0]) {
+        if (!job->job.cancelled)
+            TraceLog(LOG_INFO, "TRANSCODE: %zu copies, %llu MB", job->cache.count,
+                     (unsigned long long) job->cache.size >> 20);
+    } else if (!job->job.cancelled && job->ok) {
+        TraceLog(LOG_INFO, "TRANSCODE: %s, %.1f seconds of audio in %.2f seconds", job->path, job->duration, job->elapsed);
+
+        // Playing the original, move over to the copy where we are now
+        const Song* curr_song = plug_get_curr_song();
+        if (curr_song && curr_song->id == job->song_id && plug->music_loaded && FileExists(job->out_path)) {
+            const float position = plug_music_time();
+            if (!plug_swap_music(job->out_path, position))
+                TraceLog(LOG_ERROR, "TRANSCODE: couldn't load %s", job->out_path);
+        }
+    } else if (!job->job.cancelled) TraceLog(LOG_WARNING, "TRANSCODE: couldn't transcode %s", job->path);
+
+    free(job);
+}
+#endif
+
+// Remembers when the song was played, see plug_transcode_schedule()
+void plug_transcode_played(const Song* song)
+{
+    Transcode_Recent* recent = plug->transcode_recent;
+    size_t count = plug->transcode_recent_count;
+    for (size_t k = 0; k < count; ++k) {
+        if (recent[k].song_id != song->id) continue;
+        memmove(recent + k, recent + k + 1, (--count - k)*sizeof(*recent));
+        break;
+    }
+
+    count = MIN(count, TRANSCODE_RECENT - 1);
+    memmove(recent + 1, recent, count*sizeof(*recent));
+    recent[0] = (Transcode_Recent) { .song_id = song->id, .song_hint = song - plug->pl.songs, .played = time(NULL) };
+    plug->transcode_recent_count = count + 1;
+    plug->transcode_recheck = true;
+}
+
+#ifdef TRANSCODE_QOA
+// NULL only tallies the cache
+static bool transcode_submit(const Song* song, time_t recency)
+{
+    char out_path[TEXT_CAP] = {0};
+    if (song) {
+        if (is_song_skipped(song) || !is_transcodable(song->path) || recency <= plug->transcode_floor) return false;
+        if (!plug_transcode_cache_path(song->path, out_path) || FileExists(out_path)) return false;
+    }
+
+    Transcode_Job* job = calloc(1, sizeof(*job));
+    assert(job != NULL && "Buy more RAM lol");
+    job->job.run = transcode_job_run;
+    job->job.done = transcode_job_done;
+    job->budget = plug->transcode_budget;
+    job->recency = recency;
+    strcpy(job->cache_dir, plug->cache_dir);
+    if (song) {
+        job->song_id = song->id;
+        strcpy(job->path, song->path);
+        strcpy(job->out_path, out_path);
+    }
+
+    plug->transcoding = true;
+    plug_idle_workers_submit(&job->job);
+    return true;
+}
+#endif
+
+// One track at a time on the idle worker: the playing and upcoming ones first, then the recently
+// played ones, then the rest in playlist order while there's room. A track whose copy would be the
+// least recently played one is left alone, or a full cache would churn through every launch.
+void plug_transcode_schedule(void)
+{
+#ifdef TRANSCODE_QOA
+    if (plug->transcoding || plug->idle_workers.count == 0) return;
+
+    // Copies left from earlier runs count against the budget
+    if (!plug->transcode_scanned) {
+        transcode_submit(NULL, 0);
+        return;
+    }
+
+    const Playlist* pl = &plug->pl;
+    if (plug->transcode_recheck && pl->count > 0) {
+        plug->transcode_recheck = false;
+        const time_t now = time(NULL);
+
+        size_t ahead[PREFLIGHT_AHEAD + 1] = { pl->curr };
+        size_t ahead_count = 1;
+        for (size_t k = 0; k < PREFLIGHT_AHEAD; ++k) {
+            if (plug->shuffle_mode && k < pl->upcoming_count) ahead[ahead_count++] = pl->upcoming[k];
+            else if (!plug->shuffle_mode && k + 1 < pl->count) ahead[ahead_count++] = (pl->curr + k + 1) % pl->count;
+        }
+        for (size_t k = 0; k < ahead_count; ++k)
+            if (ahead[k] < pl->count && transcode_submit(&pl->songs[ahead[k]], now)) return;
+
+        for (size_t k = 0; k < plug->transcode_recent_count; ++k) {
+            const Transcode_Recent* recent = &plug->transcode_recent[k];
+            const Song* song = plug_find_song(recent->song_id, recent->song_hint);
+            if (song && transcode_submit(song, recent->played)) return;
+        }
+    }
+
+    // Never played, so their copies would be the first to go
+    if (plug->transcode_floor >= 0) return;
+    for (size_t scanned = 0; scanned < TRANSCODE_SCAN_PER_FRAME && plug->transcode_cursor < pl->count; ++scanned)
+        if (transcode_submit(&pl->songs[plug->transcode_cursor++], 0)) return;
+#endif
+}
+
+static size_t library_hash(const char* path)
+{
+    return hash_bytes((const unsigned char*) path, strlen(path));
+}
+
+static void library_table_put(Library* lib, size_t index)
+{
+    const size_t mask = lib->table_cap - 1;
+    size_t slot = library_hash(plug->pl.songs[index].path) & mask;
+    while (lib->table[slot]) slot = (slot + 1) & mask;
+    lib->table[slot] = index + 1;
+    lib->table_used++;
+}
+
+static void library_table_build(void)
+{
+    Library* lib = &plug->library;
+
+    size_t cap = DA_INIT_CAP;
+    while (cap < plug->pl.count*4) cap *= 2;
+    if (cap != lib->table_cap) {
+        lib->table = realloc(lib->table, cap*sizeof(*lib->table));
+        assert(lib->table != NULL && "Buy more RAM lol");
+        lib->table_cap = cap;
+    }
+
+    memset(lib->table, 0, lib->table_cap*sizeof(*lib->table));
+    lib->table_used = 0;
+    for (size_t i = 0; i < plug->pl.count; ++i) library_table_put(lib, i);
+    lib->table_songs = plug->pl.count;
+}
+
+// Renamed songs are put again under their new path, the old slot just stops matching
+static void library_table_insert(size_t index)
+{
+    Library* lib = &plug->library;
+    if ((lib->table_used + 1)*2 > lib->table_cap) library_table_build();
+    else library_table_put(lib, index);
+}
+
+static void library_table_sync(void)
+{
+    Library* lib = &plug->library;
+    if (lib->table_cap == 0 || lib->table_songs > plug->pl.count) library_table_build();
+    while (lib->table_songs < plug->pl.count) library_table_insert(lib->table_songs++);
+}
+
+// Songs at `path`, one per call, `*probe` starts at 0
+static Song* library_find(const char* path, size_t* probe)
+{
+    const Library* lib = &plug->library;
+    if (lib->table_cap == 0) return NULL;
+
+    const size_t mask = lib->table_cap - 1;
+    const size_t start = library_hash(path);
+    for (;; ++*probe) {
+        const size_t slot = lib->table[(start + *probe) & mask];
+        if (slot == 0) return NULL;
+
+        Song* song = &plug->pl.songs[slot - 1];
+        if (strcmp(song->path, path) == 0) {
+            ++*probe;
+            return song;
+        }
+    }
+}
+
+static bool library_is_under(const char* path, const char* dir, size_t dir_len)
+{
+    return strncmp(path, dir, dir_len) == 0 && path[dir_len] == '/';
+}
+
+static void library_watch(const char* dir)
+{
+    Library* lib = &plug->library;
+
+    const int wd = inotify_add_watch(lib->fd, dir, LIBRARY_WATCH_MASK);
+    if (wd < 0) {
+        TraceLog(LOG_WARNING, "LIBRARY: couldn't watch %s: %s", dir, strerror(errno));
+        return;
+    }
+
+    if ((size_t) wd >= lib->dirs_cap) {
+        const size_t cap = MAX((size_t) wd + 1, lib->dirs_cap*2);
+        lib->dirs = realloc(lib->dirs, cap*sizeof(*lib->dirs));
+        assert(lib->dirs != NULL && "Buy more RAM lol");
+        memset(lib->dirs + lib->dirs_cap, 0, (cap - lib->dirs_cap)*sizeof(*lib->dirs));
+        lib->dirs_cap = cap;
+    }
+
+    free(lib->dirs[wd]);
+    lib->dirs[wd] = strdup(dir);
+    assert(lib->dirs[wd] != NULL && "Buy more RAM lol");
+}
+
+static void library_song_gone(Song* song)
+{
+    if (song->gone) return;
+    song->gone = true;
+    plug->library.gone++;
+}
+
+// New content, or back after being gone: checked and fingerprinted again
+static void library_song_changed(Song* song)
+{
+    const size_t index = song - plug->pl.songs;
+
+    if (song->gone) {
+        song->gone = false;
+        plug->library.gone--;
+    }
+
+    if (song->check_state != CHECK_PENDING) song->check_state = CHECK_NONE;
+    song->duplicate_of = 0;
+    song->generation++;
+
+    // A fingerprint in flight is of the old content, it's dropped when it lands
+    if (song->fp_state != FP_NONE) {
+        if (song->fp_state == FP_DONE) fp_index_remove(&plug->fp, &song->id, 1);
+        song->fp_state = FP_NONE;
+        plug->fp.cursor = MIN(plug->fp.cursor, index);
+    }
+
+    // Whatever duplicated the old content doesn't duplicate this one
+    for (size_t i = 0; i < plug->pl.count; ++i)
+        if (plug->pl.songs[i].duplicate_of == song->id)
+            plug->pl.songs[i].duplicate_of = 0;
+
+    plug->transcode_cursor = MIN(plug->transcode_cursor, index);
+}
+
+static void library_song_renamed(Song* song, const char* path)
+{
+    strcpy(song->path, path);
+    library_table_insert(song - plug->pl.songs);
+    plug->transcode_cursor = MIN(plug->transcode_cursor, (size_t) (song - plug->pl.songs));
+
+    if (plug->music_loaded && song == plug_get_curr_song()) {
+        char song_name[256];
+        get_song_name(song->path, song_name, sizeof(song_name));
+        snprintf(plug->song_name.text, TEXT_CAP, "Song name: %s", song_name);
+    }
+}
+
+// Already known songs are left alone unless `changed`, or they were gone
+static void library_file_added(const char* path, bool changed)
+{
+    bool found = false;
+    size_t probe = 0;
+    for (Song* song; (song = library_find(path, &probe)); found = true)
+        if (changed || song->gone) library_song_changed(song);
+
+    if (!found && is_music(path) && plug_push_song(path)) library_table_sync();
+}
+
+static void library_file_removed(const char* path)
+{
+    size_t probe = 0;
+    for (Song* song; (song = library_find(path, &probe));) library_song_gone(song);
+}
+
+static int compare_library_entries(const void* a, const void* b)
+{
+    return strcmp(((const Library_Entry*) a)->name, ((const Library_Entry*) b)->name);
+}
+
+// Watches `dir` and everything under it, and adds the songs that aren't in the playlist yet
+static void library_scan(const char* dir)
+{
+    Library* lib = &plug->library;
+    if (lib->watching) library_watch(dir);
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        TraceLog(LOG_WARNING, "LIBRARY: couldn't open %s: %s", dir, strerror(errno));
+        return;
+    }
+
+    // Sorted, so that an album lands in track order
+    Library_Entry* entries = NULL;
+    size_t count = 0, cap = 0;
+    for (struct dirent* ent; (ent = readdir(d));) {
+        if (ent->d_name[0] == '.') continue;
+        if (count >= cap) {
+            cap = cap == 0 ? 64 : cap*2;
+            entries = realloc(entries, cap*sizeof(*entries));
+            assert(entries != NULL && "Buy more RAM lol");
+        }
+        entries[count].name = strdup(ent->d_name);
+        entries[count].type = ent->d_type;
+        assert(entries[count].name != NULL && "Buy more RAM lol");
+        count++;
+    }
+    closedir(d);
+    if (count > 0) qsort(entries, count, sizeof(*entries), compare_library_entries);
+
+    char path[TEXT_CAP];
+    for (size_t i = 0; i < count; ++i) {
+        const bool fits = snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name) < (int) sizeof(path);
+        free(entries[i].name);
+        if (!fits) continue;
+
+        struct stat st;
+        bool is_dir = entries[i].type == DT_DIR;
+        if (entries[i].type == DT_UNKNOWN && lstat(path, &st) == 0) is_dir = S_ISDIR(st.st_mode);
+
+        if (is_dir) library_scan(path);
+        else if (is_music(path)) library_file_added(path, false);
+    }
+
+    free(entries);
+}
+
+static void library_remove_under(const char* dir, bool unwatch)
+{
+    Library* lib = &plug->library;
+    const size_t n = strlen(dir);
+
+    for (size_t i = 0; i < plug->pl.count; ++i)
+        if (library_is_under(plug->pl.songs[i].path, dir, n)) library_song_gone(&plug->pl.songs[i]);
+
+    if (!unwatch) return;
+    for (size_t wd = 0; wd < lib->dirs_cap; ++wd) {
+        if (!lib->dirs[wd] || (strcmp(lib->dirs[wd], dir) != 0 && !library_is_under(lib->dirs[wd], dir, n))) continue;
+        inotify_rm_watch(lib->fd, wd);
+        free(lib->dirs[wd]);
+        lib->dirs[wd] = NULL;
+    }
+}
+
+// The watches follow a renamed directory by themselves, only their paths need fixing
+static void library_rename_under(const char* from, const char* to)
+{
+    Library* lib = &plug->library;
+    const size_t n = strlen(from), m = strlen(to);
+
+    char path[TEXT_CAP];
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        Song* song = &plug->pl.songs[i];
+        if (!library_is_under(song->path, from, n)) continue;
+
+        if (snprintf(path, sizeof(path), "%s%s", to, song->path + n) >= (int) sizeof(path)) library_song_gone(song);
+        else library_song_renamed(song, path);
+    }
+
+    for (size_t wd = 0; wd < lib->dirs_cap; ++wd) {
+        char* dir = lib->dirs[wd];
+        if (!dir || (strcmp(dir, from) != 0 && !library_is_under(dir, from, n))) continue;
+
+        char* renamed = malloc(m + strlen(dir + n) + 1);
+        assert(renamed != NULL && "Buy more RAM lol");
+        strcpy(renamed, to);
+        strcpy(renamed + m, dir + n);
+        free(dir);
+        lib->dirs[wd] = renamed;
+    }
+}
+
+static void library_move(const char* from, const char* to, bool is_dir)
+{
+    if (is_dir) {
+        library_rename_under(from, to);
+        return;
+    }
+
+    // Renaming over a song replaces it, renaming away from a supported extension removes it
+    library_file_removed(to);
+    if (!is_music(to)) {
+        library_file_removed(from);
+        return;
+    }
+
+    bool found = false;
+    for (Song* song; (song = library_find(from, &(size_t) {0})); found = true) library_song_renamed(song, to);
+    if (!found) library_file_added(to, true);
+}
+
+// A dropped directory was deleted or moved itself. There's no telling where to, so its songs go.
+static void library_root_gone(size_t r)
+{
+    Library* lib = &plug->library;
+    TraceLog(LOG_INFO, "LIBRARY: %s was moved or deleted, dropping its songs", lib->roots[r]);
+    library_remove_under(lib->roots[r], true);
+    free(lib->roots[r]);
+    lib->roots[r] = lib->roots[--lib->roots_count];
+}
+
+// Moved out of the watched directories
+static void library_move_away(void)
+{
+    Library* lib = &plug->library;
+    if (lib->move_is_dir) library_remove_under(lib->move_from, true);
+    else library_file_removed(lib->move_from);
+    lib->move_pending = false;
+}
+
+static void library_apply(const struct inotify_event* ev)
+{
+    Library* lib = &plug->library;
+
+    // The kernel queues a rename's two halves back to back
+    if (lib->move_pending && !((ev->mask & IN_MOVED_TO) && ev->cookie == lib->move_cookie)) library_move_away();
+
+    if (ev->mask & IN_IGNORED) {
+        if (ev->wd >= 0 && (size_t) ev->wd < lib->dirs_cap) {
+            free(lib->dirs[ev->wd]);
+            lib->dirs[ev->wd] = NULL;
+        }
+        return;
+    }
+    // Only roots matter here, for the others the parent's watch reports it
+    if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) {
+        if (ev->wd < 0 || (size_t) ev->wd >= lib->dirs_cap || !lib->dirs[ev->wd]) return;
+        for (size_t r = 0; r < lib->roots_count; ++r) {
+            if (strcmp(lib->roots[r], lib->dirs[ev->wd]) != 0) continue;
+            library_root_gone(r);
+            break;
+        }
+        return;
+    }
+    if (ev->len == 0 || ev->wd < 0 || (size_t) ev->wd >= lib->dirs_cap || !lib->dirs[ev->wd]) return;
+
+    char path[TEXT_CAP];
+    if (snprintf(path, sizeof(path), "%s/%s", lib->dirs[ev->wd], ev->name) >= (int) sizeof(path)) return;
+
+    const bool is_dir = ev->mask & IN_ISDIR;
+    if (ev->mask & IN_MOVED_FROM) {
+        lib->move_pending = true;
+        lib->move_is_dir = is_dir;
+        lib->move_cookie = ev->cookie;
+        strcpy(lib->move_from, path);
+    } else if ((ev->mask & IN_MOVED_TO) && lib->move_pending) {
+        lib->move_pending = false;
+        library_move(lib->move_from, path, is_dir);
+    } else if (is_dir) {
+        if (ev->mask & IN_DELETE) library_remove_under(path, false);
+        else if (ev->name[0] != '.') library_scan(path);
+    } else if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) library_file_added(path, true);
+    else if (ev->mask & IN_DELETE) library_file_removed(path);
+    // IN_CREATE of a file: it's added once written, on IN_CLOSE_WRITE
+}
+
+// Events were dropped, so whatever the playlist holds under the roots gets checked against the disk
+static void library_rescan(void)
+{
+    Library* lib = &plug->library;
+    lib->overflows++;
+    TraceLog(LOG_WARNING, "LIBRARY: too many changes at once, rescanning");
+
+    struct stat st;
+    for (size_t i = 0; i < plug->pl.count; ++i) {
+        Song* song = &plug->pl.songs[i];
+        for (size_t r = 0; r < lib->roots_count; ++r) {
+            if (!library_is_under(song->path, lib->roots[r], strlen(lib->roots[r]))) continue;
+            if (stat(song->path, &st) < 0) library_song_gone(song);
+            break;
+        }
+    }
+
+    for (size_t r = 0; r < lib->roots_count; ++r) library_scan(lib->roots[r]);
+}
+
+// Drops the gone songs in one pass, keeping the playing one and the order of the rest,
+// and moves every index into the playlist along
+static void library_compact(void)
+{
+    Library* lib = &plug->library;
+    Playlist* pl = &plug->pl;
+    const Song* playing = plug->music_loaded ? plug_get_curr_song() : NULL;
+
+    size_t* removed = malloc(lib->gone*sizeof(*removed));
+    assert(removed != NULL && "Buy more RAM lol");
+    size_t removed_count = 0;
+
+    size_t curr = 0, prev = SIZE_MAX, fp_cursor = SIZE_MAX, transcode_cursor = SIZE_MAX;
+    size_t upcoming[PREFLIGHT_AHEAD];
+    for (size_t k = 0; k < pl->upcoming_count; ++k) upcoming[k] = SIZE_MAX;
+
+    lib->lingering_id = 0;
+    size_t j = 0;
+    for (size_t i = 0; i < pl->count; ++i) {
+        Song* song = &pl->songs[i];
+        const bool keep = !song->gone || song == playing;
+
+        // Removed ones map to the song after them
+        if (i == pl->curr) curr = j;
+        if (i == pl->prev && keep) prev = j;
+        if (i == plug->fp.cursor) fp_cursor = j;
+        if (i == plug->transcode_cursor) transcode_cursor = j;
+        for (size_t k = 0; k < pl->upcoming_count; ++k)
+            if (pl->upcoming[k] == i && keep) upcoming[k] = j;
+
+        if (!keep) {
+            removed[removed_count++] = song->id;
+            continue;
+        }
+
+        if (song->gone) lib->lingering_id = song->id;
+        if (i != j) pl->songs[j] = *song;
+        j++;
+    }
+
+    pl->count = j;
+    pl->curr = curr < j ? curr : 0;
+    pl->prev = prev != SIZE_MAX ? prev : pl->curr;
+    plug->fp.cursor = MIN(fp_cursor, j);
+    plug->transcode_cursor = MIN(transcode_cursor, j);
+
+    size_t upcoming_count = 0;
+    for (size_t k = 0; k < pl->upcoming_count; ++k)
+        if (upcoming[k] != SIZE_MAX) pl->upcoming[upcoming_count++] = upcoming[k];
+    pl->upcoming_count = upcoming_count;
+
+    qsort(removed, removed_count, sizeof(*removed), compare_ids);
+    for (size_t i = 0; i < pl->count; ++i) {
+        Song* song = &pl->songs[i];
+        if (song->duplicate_of && bsearch(&song->duplicate_of, removed, removed_count, sizeof(*removed), compare_ids))
+            song->duplicate_of = 0;
+    }
+    fp_index_remove(&plug->fp, removed, removed_count);
+
+    lib->gone = lib->lingering_id != 0;
+    lib->table_songs = SIZE_MAX;
+    free(removed);
+}
+
+// Watches a directory dropped on the player, adding the songs under it
+bool plug_library_add(const char* dir)
+{
+    Library* lib = &plug->library;
+
+    char* root = realpath(dir, NULL);
+    if (!root || strlen(root) >= TEXT_CAP) {
+        TraceLog(LOG_ERROR, "LIBRARY: couldn't add %s: %s", dir, root ? "path too long" : strerror(errno));
+        free(root);
+        return false;
+    }
+
+    if (!lib->watching) {
+        lib->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (lib->fd >= 0) lib->watching = true;
+        else TraceLog(LOG_WARNING, "LIBRARY: not watching for changes: %s", strerror(errno));
+    }
+
+    bool known = false;
+    for (size_t r = 0; r < lib->roots_count && !known; ++r)
+        known = strcmp(lib->roots[r], root) == 0 || library_is_under(root, lib->roots[r], strlen(lib->roots[r]));
+
+    if (!known) {
+        if (lib->roots_count >= lib->roots_cap) {
+            lib->roots_cap = lib->roots_cap == 0 ? 16 : lib->roots_cap*2;
+            lib->roots = realloc(lib->roots, lib->roots_cap*sizeof(*lib->roots));
+            assert(lib->roots != NULL && "Buy more RAM lol");
+        }
+        lib->roots[lib->roots_count++] = root;
+    }
+
+    const size_t before = plug->pl.count;
+    library_table_sync();
+    library_scan(root);
+    TraceLog(LOG_INFO, "LIBRARY: added %zu songs from %s", plug->pl.count - before, root);
+
+    if (known) free(root);
+    return plug->pl.count > before;
+}
+
+// Applies what changed on disk since the last frame as one batch
+void plug_library_poll(void)
+{
+    Library* lib = &plug->library;
+    if (!lib->watching) return;
+
+    if (lib->lingering_id) {
+        const Song* curr = plug_get_curr_song();
+        if (!plug->music_loaded || !curr || curr->id != lib->lingering_id) library_compact();
+    }
+
+    char buf[LIBRARY_READ_CAP] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const double start = thread_cpu_time();
+    size_t events = 0;
+    bool overflowed = false;
+
+    for (;;) {
+        const ssize_t n = read(lib->fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EINTR)
+                TraceLog(LOG_WARNING, "LIBRARY: couldn't read events: %s", strerror(errno));
+            break;
+        }
+
+        if (events == 0) library_table_sync();
+        for (ssize_t off = 0; off < n;) {
+            const struct inotify_event* ev = (const struct inotify_event*) (buf + off);
+            off += sizeof(*ev) + ev->len;
+            events++;
+
+            if (ev->mask & IN_Q_OVERFLOW) overflowed = true;
+            else library_apply(ev);
+        }
+    }
+    if (events == 0) return;
+
+    if (lib->move_pending) library_move_away();
+    if (overflowed) library_rescan();
+    if (lib->gone > 0) library_compact();
+
+    const double elapsed = thread_cpu_time() - start;
+    lib->events += events;
+    lib->batches++;
+    lib->cpu_time += elapsed;
+    lib->worst_batch = MAX(lib->worst_batch, elapsed);
+
+    TraceLog(LOG_INFO, "LIBRARY: %zu changes applied in %.2f ms, %zu songs (%.2f us/change over %zu batches)",
+             events, elapsed*1e3, plug->pl.count, lib->cpu_time*1e6 / lib->events, lib->batches);
+}
+
+void plug_library_close(void)
+{
+    Library* lib = &plug->library;
+    if (lib->watching) close(lib->fd);
+
+    for (size_t r = 0; r < lib->roots_count; ++r) free(lib->roots[r]);
+    for (size_t wd = 0; wd < lib->dirs_cap; ++wd) free(lib->dirs[wd]);
+    free(lib->roots);
+    free(lib->dirs);
+    free(lib->table);
+    memset(lib, 0, sizeof(*lib));
+}
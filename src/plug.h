@@ -1,6 +1,14 @@
 #ifndef PLUG_H
 #define PLUG_H
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
 #define WINDOW_WIDTH 1000
 #define WINDOW_HEIGHT 600
 
@@ -22,6 +30,22 @@
 #   define CROSSED_SHUFFLE_PATH "resources/crossed_shuffle.png"
 #endif
 
+#define CTL_SOCKET_NAME "player.sock"
+
+// $XDG_RUNTIME_DIR/player.sock, only the user can get in there. /tmp/player-<uid>.sock without it.
+// False if the path doesn't fit in sun_path.
+static inline bool ctl_socket_addr(struct sockaddr_un* addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    const char* dir = getenv("XDG_RUNTIME_DIR");
+    const int n = dir && dir[0]
+        ? snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/" CTL_SOCKET_NAME, dir)
+        : snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/player-%u.sock", (unsigned) getuid());
+    return n > 0 && (size_t) n < sizeof(addr->sun_path);
+}
+
 #define FN(name) name##_t name
 
 #define FN_SYM(name, lib, do_)                             \
@@ -37,5 +61,6 @@ typedef void  (*plug_free_t)(void);
 typedef void  (*plug_frame_t)(void);
 typedef void* (*plug_pre_reload_t)(void);
 typedef void  (*plug_post_reload_t)(void*);
+typedef bool  (*plug_input_record_t)(const char*, unsigned int);
 
 #endif // PLUG_H
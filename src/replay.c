@@ -0,0 +1,138 @@
+// Replays an input log recorded with `build/out --record <input.log>` through plug_frame(),
+// in a hidden window and without an audio device, as fast as the frames go.
+//
+// Timing is per plug_frame() call. Background jobs are drained between frames so they land
+// on the same frame every run, and the time spent waiting on them isn't counted.
+#include "plug.c"
+
+#include <getopt.h>
+
+#define REPLAY_HITCH_MS (1000./60)
+
+static const double REPLAY_BUCKETS_MS[] = {1, 2, 4, 8, 16, 33, 66};
+
+static int compare_doubles(const void* a, const void* b)
+{
+    const double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, size_t n, double p)
+{
+    return sorted[MIN((size_t) (p*n), n - 1)];
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [-o frames.tsv] [-p max_p99_ms] <input.log>\n", program);
+}
+
+int main(int argc, char** argv)
+{
+    const char* frames_path = NULL;
+    double max_p99 = 0.;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "o:p:h")) != -1) {
+        switch (opt) {
+        case 'o': frames_path = optarg; break;
+        case 'p': max_p99 = strtod(optarg, NULL); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Player replay");
+    SetTargetFPS(0);
+
+    // No InitAudioDevice(): music plays against the null sink
+    replay_path = argv[optind];
+    plug_init();
+    if (!plug->input.replaying) {
+        plug_free();
+        CloseWindow();
+        return 1;
+    }
+
+    double* frames = NULL;
+    size_t count = 0, cap = 0;
+    while (!plug_input_replay_done()) {
+        const double start = monotonic_time();
+        plug_frame();
+        const double ms = (monotonic_time() - start)*1e3;
+
+        if (count >= cap) {
+            cap = cap == 0 ? DA_INIT_CAP : cap*2;
+            frames = realloc(frames, cap*sizeof(*frames));
+            assert(frames != NULL && "Buy more RAM lol");
+        }
+        frames[count++] = ms;
+
+        plug_workers_drain();
+    }
+
+    plug_free();
+    CloseWindow();
+
+    if (count == 0) {
+        fprintf(stderr, "ERROR: %s has no frames\n", argv[optind]);
+        return 1;
+    }
+
+    if (frames_path) {
+        FILE* f = fopen(frames_path, "w");
+        if (!f) {
+            fprintf(stderr, "ERROR: could not write %s: %s\n", frames_path, strerror(errno));
+            return 1;
+        }
+        fprintf(f, "# frame\tms\n");
+        for (size_t i = 0; i < count; ++i) fprintf(f, "%zu\t%.4f\n", i, frames[i]);
+        fclose(f);
+    }
+
+    double total = 0.;
+    size_t hitches = 0;
+    size_t buckets[DA_LEN(REPLAY_BUCKETS_MS) + 1] = {0};
+    for (size_t i = 0; i < count; ++i) {
+        total += frames[i];
+        hitches += frames[i] > REPLAY_HITCH_MS;
+
+        size_t b = 0;
+        while (b < DA_LEN(REPLAY_BUCKETS_MS) && frames[i] >= REPLAY_BUCKETS_MS[b]) b++;
+        buckets[b]++;
+    }
+
+    qsort(frames, count, sizeof(*frames), compare_doubles);
+    const double p99 = percentile(frames, count, .99);
+
+    // Same `name value` lines as the benchmarks, for scripts
+    printf("frames\t%zu\n", count);
+    printf("mean_ms\t%.4f\n", total/count);
+    printf("p50_ms\t%.4f\n", percentile(frames, count, .50));
+    printf("p90_ms\t%.4f\n", percentile(frames, count, .90));
+    printf("p99_ms\t%.4f\n", p99);
+    printf("max_ms\t%.4f\n", frames[count - 1]);
+    printf("hitches\t%zu\n", hitches);
+
+    for (size_t b = 0; b <= DA_LEN(REPLAY_BUCKETS_MS); ++b) {
+        if (b < DA_LEN(REPLAY_BUCKETS_MS)) fprintf(stderr, "   < %3.0f ms", REPLAY_BUCKETS_MS[b]);
+        else fprintf(stderr, "  >= %3.0f ms", REPLAY_BUCKETS_MS[b - 1]);
+        fprintf(stderr, " %8zu  %5.1f%%\n", buckets[b], 100.*buckets[b]/count);
+    }
+
+    free(frames);
+
+    if (max_p99 > 0 && p99 > max_p99) {
+        fprintf(stderr, "FAIL: p99 frame time %.2f ms is over %.2f ms\n", p99, max_p99);
+        return 1;
+    }
+
+    return 0;
+}